@@ -5,6 +5,7 @@
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
+#include <cstring>
 #include <mutex>
 #include <string>
 #include <string_view>
@@ -77,6 +78,14 @@ public:
         if (len == 0) return;
 
         std::scoped_lock lock(mutex_);
+        if (resync_)
+        {
+            auto sync = find_ts_sync(buf, len);
+            if (sync == len) return;
+            buf += sync;
+            len -= sync;
+            resync_ = false;
+        }
         if (stream_.size() >= stream_buffer_max_)
         {
             stream_.clear();
@@ -85,6 +94,18 @@ public:
         cond_.notify_all();
     }
 
+    /**
+     * input lost data: drop the buffered bytes, resume at the next TS sync byte,
+     * flush the codec and skip packets until the next key frame
+     */
+    void discontinuity()
+    {
+        std::scoped_lock lock(mutex_);
+        stream_.clear();
+        resync_ = true;
+        flush_ = true;
+    }
+
     void run()
     {
         while (!interrupted_)
@@ -101,10 +122,17 @@ public:
         }
 
         auto pkt = av_packet_alloc();
+        bool wait_key = false;
         while (!interrupted_ and av_read_frame(fmt_ctx_, pkt) >= 0)
         {
             if (interrupted_) break;
-            if (pkt->stream_index == video_index_)
+            if (flush_.exchange(false))
+            {
+                avcodec_flush_buffers(dec_ctx_);
+                wait_key = true;
+            }
+            if (wait_key && pkt->stream_index == video_index_ && (pkt->flags & AV_PKT_FLAG_KEY)) wait_key = false;
+            if (pkt->stream_index == video_index_ && !wait_key)
             {
                 auto arr = ff_decode(dec_ctx_, pkt);
                 for (auto &&f : arr)
@@ -214,6 +242,18 @@ private:
         return read;
     }
 
+    // first offset where a 0x47 is followed by another one a packet later
+    static size_t find_ts_sync(const uint8_t *buf, size_t len)
+    {
+        constexpr size_t TS_PACKET = 188;
+        for (auto p = buf; (p = (const uint8_t *)memchr(p, 0x47, buf + len - p)) != nullptr; ++p)
+        {
+            auto i = size_t(p - buf);
+            if (i + TS_PACKET >= len || buf[i + TS_PACKET] == 0x47) return i;
+        }
+        return len;
+    }
+
     void process_yuv_frame(AVFrame *frame)
     {
         // printf("time=%lld, pts=%lld, dts=%lld\n", time(nullptr), frame->pts, frame->pkt_dts);
@@ -245,6 +285,8 @@ private:
     std::mutex mutex_;
     std::vector<uint8_t> stream_;
     std::condition_variable cond_;
+    bool resync_{ false };
+    std::atomic<bool> flush_{ false };
 
     AVFormatContext *fmt_ctx_{ nullptr };
     AVCodecContext *dec_ctx_{ nullptr };
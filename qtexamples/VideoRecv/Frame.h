@@ -1,11 +1,13 @@
 ﻿#pragma once
 
+#include <cstdint>
 #include <vector>
 
 struct Frame
 {
     size_t index{ 0 };
     double time{ 0 };
+    uint64_t yearUs{ 0 };  // 遥测消息中的年积微秒, 由解析级换算成 time
     std::vector<uint8_t> payload;
     size_t offset{ 0 };
 };
@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include <QImage>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+// 三缓冲的 "最新帧" 信箱: 解码线程无锁覆盖写入, 界面线程按屏幕刷新率取走最新一帧, 来不及显示的帧直接被覆盖
+class FrameMailbox
+{
+public:
+    struct Status
+    {
+        size_t decoded;
+        size_t displayed;
+        size_t overwritten;
+    };
+
+public:
+    // 解码线程调用: 把 BGRA 图像拷贝进后台缓冲并发布
+    void write(const uint8_t *buf, size_t pitch, int width, int height)
+    {
+        auto &image = slots_[back_];
+        if (image.width() != width || image.height() != height)
+        {
+            image = QImage(width, height, QImage::Format_RGB32);
+        }
+        auto line = std::min<size_t>(pitch, image.bytesPerLine());
+        for (int y = 0; y < height; ++y)
+        {
+            memcpy(image.scanLine(y), buf + y * pitch, line);
+        }
+
+        auto prev = middle_.exchange(back_ | DIRTY, std::memory_order_acq_rel);
+        back_ = prev & INDEX;
+        decoded_++;
+        if (prev & DIRTY) overwritten_++;
+    }
+
+    // 界面线程调用: 有新帧时换到前台并返回 true
+    bool take()
+    {
+        if (!(middle_.load(std::memory_order_acquire) & DIRTY)) return false;
+        auto prev = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & INDEX;
+        displayed_++;
+        return true;
+    }
+
+    // 只能在界面线程使用, 下次 take() 之前一直有效
+    const QImage &front() const
+    {
+        return slots_[front_];
+    }
+
+    Status status() const
+    {
+        return { decoded_, displayed_, overwritten_ };
+    }
+
+private:
+    static constexpr int INDEX = 0x3;
+    static constexpr int DIRTY = 0x4;
+
+    QImage slots_[3];
+    int back_{ 0 };   // 解码线程独占
+    int front_{ 1 };  // 界面线程独占
+    std::atomic<int> middle_{ 2 };
+
+    std::atomic<size_t> decoded_{ 0 };
+    std::atomic<size_t> displayed_{ 0 };
+    std::atomic<size_t> overwritten_{ 0 };
+};
@@ -0,0 +1,162 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define IDLE_FILTER_SSE2 1
+#endif
+
+// 空闲填充检测: PCM 通道在没有视频数据时会填充 5555/FADE/DEAD 等固定字,
+// 0000 在压缩视频里也会成段出现, 不在默认填充字里, 确认信道用它填充时再在界面上加.
+// 按 16 字节一块比较整段数据, 找出长度不小于 minRun 的填充段并跳过.
+// 填充字可能从奇数字节开始(跨字边界), 所以每个填充字同时登记字节交换后的形式.
+class IdleFilter
+{
+public:
+    constexpr static std::string_view DEFAULT_PATTERNS = "5555,FADE,DEAD";
+    constexpr static size_t BLOCK = 16;
+
+public:
+    IdleFilter(std::string_view patterns = DEFAULT_PATTERNS, size_t minRun = 64)
+        : minRun_(std::max(minRun, BLOCK))
+    {
+        for (auto w : parse(patterns))
+        {
+            addPattern(uint8_t(w >> 8), uint8_t(w));
+            addPattern(uint8_t(w), uint8_t(w >> 8));
+        }
+    }
+
+public:
+    /**
+     * 扫描 [ptr, ptr + len), 把非填充的数据段依次交给 payload(const uint8_t *, size_t)
+     * 整块都是填充时不受 minRun 限制直接丢弃
+     * @return 被丢弃的填充字节数
+     */
+    template <class F>
+    size_t scan(const uint8_t *ptr, size_t len, F &&payload) const
+    {
+        size_t idle = 0;
+        size_t pos = 0;  // 尚未输出的数据起点
+        size_t i = 0;    // 始终为偶数, 填充字的相位由绝对下标的奇偶决定
+        while (i + BLOCK <= len)
+        {
+            auto k = match(ptr + i);
+            if (k < 0)
+            {
+                i += BLOCK;
+                continue;
+            }
+
+            auto begin = i;
+            while (begin > pos && ptr[begin - 1] == patterns_[k].bytes[(begin - 1) & 1])
+            {
+                --begin;
+            }
+            auto end = i + BLOCK;
+            for (int m; end + BLOCK <= len && (m = match(ptr + end)) >= 0; end += BLOCK)
+            {
+                k = m;
+            }
+            while (end < len && ptr[end] == patterns_[k].bytes[end & 1])
+            {
+                ++end;
+            }
+
+            if (end - begin >= minRun_ || (begin == 0 && end == len))
+            {
+                if (begin > pos) payload(ptr + pos, begin - pos);
+                idle += end - begin;
+                pos = end;
+            }
+            i = end + (end & 1);
+        }
+        if (len < BLOCK && isIdle(ptr, len)) return len;
+        if (pos < len) payload(ptr + pos, len - pos);
+        return idle;
+    }
+
+    /** 整段都是同一种填充 */
+    bool isIdle(const uint8_t *ptr, size_t len) const
+    {
+        for (auto &p : patterns_)
+        {
+            size_t i = 0;
+            while (i < len && ptr[i] == p.bytes[i & 1])
+            {
+                ++i;
+            }
+            if (i == len) return true;
+        }
+        return false;
+    }
+
+    /** "5555,FADE,DEAD" -> 16 位填充字 */
+    static std::vector<uint16_t> parse(std::string_view text)
+    {
+        std::vector<uint16_t> words;
+        while (!text.empty())
+        {
+            auto n = text.find_first_of(", ;");
+            auto item = text.substr(0, n);
+            uint16_t w = 0;
+            if (!item.empty() && std::from_chars(item.data(), item.data() + item.size(), w, 16).ec == std::errc{})
+            {
+                words.push_back(w);
+            }
+            text = n == std::string_view::npos ? std::string_view{} : text.substr(n + 1);
+        }
+        return words;
+    }
+
+private:
+    struct Pattern
+    {
+        uint8_t bytes[2];
+        uint8_t block[BLOCK];
+    };
+
+    void addPattern(uint8_t b0, uint8_t b1)
+    {
+        for (auto &p : patterns_)
+        {
+            if (p.bytes[0] == b0 && p.bytes[1] == b1) return;
+        }
+        Pattern p{ { b0, b1 }, {} };
+        for (size_t i = 0; i < BLOCK; ++i)
+        {
+            p.block[i] = p.bytes[i & 1];
+        }
+        patterns_.push_back(p);
+    }
+
+    // 16 字节整块命中的填充字下标, 没有命中返回 -1
+    int match(const uint8_t *ptr) const
+    {
+#ifdef IDLE_FILTER_SSE2
+        auto v = _mm_loadu_si128((const __m128i *)ptr);
+        // 先判断是否以 2 字节为周期, 绝大多数视频数据在这里就被排除
+        if ((_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_srli_si128(v, 2))) & 0x3FFF) != 0x3FFF) return -1;
+        for (int k = 0; k < (int)patterns_.size(); ++k)
+        {
+            auto eq = _mm_cmpeq_epi8(v, _mm_loadu_si128((const __m128i *)patterns_[k].block));
+            if (_mm_movemask_epi8(eq) == 0xFFFF) return k;
+        }
+#else
+        for (int k = 0; k < (int)patterns_.size(); ++k)
+        {
+            if (memcmp(ptr, patterns_[k].block, BLOCK) == 0) return k;
+        }
+#endif
+        return -1;
+    }
+
+private:
+    std::vector<Pattern> patterns_;
+    size_t minRun_;
+};
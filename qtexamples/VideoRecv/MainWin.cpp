@@ -11,6 +11,7 @@
 #include <QHBoxLayout>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QScreen>
 #include <QTimeZone>
 #include <boost/asio/buffers_iterator.hpp>
 #include <boost/asio/io_context.hpp>
@@ -29,33 +30,14 @@ using namespace boost::endian;
 static QString CONFIG_FILE = QDir::homePath() + "/.atom/video_recv_test.bcfg";
 constexpr static size_t HEAD_OFFSET = 0;
 constexpr static size_t UPDATE_INTERVAL = 100;
+constexpr static size_t PARSE_QUEUE_CAPACITY = 8192;  // 接收级 -> 解析级, 以遥测消息计
+constexpr static size_t SINK_QUEUE_CAPACITY = 8192;   // 解析级 -> 通道, 以数据块计
 
-static bool is_idle_frame(const uint8_t *ptr)
-{
-    // if (ptr == nullptr)
-    //{
-    //    return true;
-    //}
-    // auto numbers = *(uint64_t *)ptr;
-
-    // return numbers == 0 || numbers == 0x5555'5555'5555'5555 || numbers == 0xFADE'FADE'FADE'FADE || numbers == 0xDEFA'DEFA'DEFA'DEFA ||
-    //       numbers == 0xDEAD'DEAD'DEAD'DEAD || numbers == 0xADDE'ADDE'ADDE'ADDE;
-    return false;
-}
-
-static bool is_idle_frame(const Frame &frame)
-{
-    // if (frame.payload.size() < 8)
-    //{
-    //    return true;
-    //}
-    // return is_idle_frame(frame.payload.data() + frame.offset);
-    return false;
-}
 
 MainWin::MainWin()
     : QFrame()
     , timer_(new QTimer(this))
+    , renderTimer_(new QTimer(this))
 {
     ui_.setupUi(this);
     ui_.label_6->hide();
@@ -71,6 +53,8 @@ MainWin::MainWin()
     ui_.Stack->setCurrentIndex(0);
 
     timer_->setSingleShot(false);
+    renderTimer_->setSingleShot(false);
+    renderTimer_->setTimerType(Qt::PreciseTimer);
 
     tasks_ = {
         [this] {
@@ -78,10 +62,12 @@ MainWin::MainWin()
             ui_.SFID->setText(QString::number(sfid_));
             ui_.FrameCount->setText(QString::number(frameCount_));
             ui_.Bytes->setText(QString::number(receivedBytes_));
+            updateStats();
         },
     };
 
     connect(timer_, &QTimer::timeout, this, &MainWin::updateDisplay);
+    connect(renderTimer_, &QTimer::timeout, this, &MainWin::renderFrames);
     connect(ui_.Start, &QPushButton::clicked, this, &MainWin::start);
     connect(ui_.Stop, &QPushButton::clicked, this, &MainWin::stop);
     connect(ui_.SaveAs, &QPushButton::clicked, this, [this]() {
@@ -107,7 +93,6 @@ MainWin::MainWin()
         ui_.CurrentConfig->setProperty("path", path);
         ui_.CurrentConfig->setText(QFileInfo(path).baseName());
     });
-    connect(this, &MainWin::imageReceived, this, &MainWin::paintImage, Qt::QueuedConnection);
 
     loadSpecifiedConfig();
 }
@@ -135,6 +120,9 @@ void MainWin::start()
     }
 
     id2channel_.clear();
+    columns_.assign(form_.videoChannelCount, {});
+    idleFilter_ = IdleFilter(form_.idlePatterns.toStdString(), form_.idleMinRun);
+    sfidTracker_.reset(form_.sfidMin, form_.sfidMax);
     interrupted_ = false;
     auto bufferCapacity = std::pow(2, form_.parseCache) * 1024;
     for (auto i = 0; i < form_.videoChannelCount; ++i)
@@ -153,25 +141,43 @@ void MainWin::start()
                 fwd->encode(frame);
             });
         }
-        decode->on_bgra_picture([idx = i, player, this](auto &&buf, auto &&len, int width, int height) {
-            QImage image((uchar *)buf, width, height, QImage::Format_RGB32);
-            emit imageReceived(idx, image.copy());
+        auto mailbox = std::make_unique<FrameMailbox>();
+        decode->on_bgra_picture([mailbox = mailbox.get()](auto &&buf, auto &&pitch, int width, int height) {
+            mailbox->write(buf, pitch, width, height);
         });
+        player->setMailbox(mailbox.get());
 
         id2channel_[i].decode_thread = std::thread([this, i] {
             if (interrupted_) return;
             id2channel_[i].decode->run();
         });
+        id2channel_[i].id = i;
         id2channel_[i].player = player;
+        id2channel_[i].mailbox = std::move(mailbox);
         id2channel_[i].decode = std::move(decode);
-        id2channel_[i].rawfile = std::ofstream(std::format("tsfile_{}.raw", i), std::ios::binary | std::ios::trunc);
-        id2channel_[i].tsfile = std::ofstream(std::format("tsfile_{}.ts", i), std::ios::binary | std::ios::trunc);
+        id2channel_[i].rawfile = std::make_unique<RecordWriter>(recordOptions(std::format("tsfile_{}.raw", i)));
+        id2channel_[i].tsfile = std::make_unique<RecordWriter>(recordOptions(std::format("tsfile_{}.ts", i)));
+
+        auto &chan = id2channel_[i];
+        chan.sink = std::make_unique<PipeStage<ChunkPtr>>(SINK_QUEUE_CAPACITY);
+        chan.sink->start([this, &chan](auto &&chunk) {
+            sinkChunk(chan, chunk);
+        });
     }
 
+    yearBeginMs_ = QDateTime({ QDate::currentDate().year(), 1, 1 }).toMSecsSinceEpoch();
+    archive_ = std::make_unique<TmArchiveWriter>(recordOptions("tmarchive"));
+    parseStage_ = std::make_unique<PipeStage<FramePtr>>(PARSE_QUEUE_CAPACITY);
+    parseStage_->start([this](auto &&frame) {
+        parseFrame(*frame);
+    });
+
     client_thread_ = std::thread([this, ip = form_.receiveIp.toStdString(), port = (uint16_t)form_.receivePort, ch = 0] {
         startReceiveTm(ip, port, ch);
     });
 
+    auto refreshRate = screen() ? screen()->refreshRate() : 60.0;
+    renderTimer_->start(std::max(1, qRound(1000.0 / refreshRate)));
     timer_->start(UPDATE_INTERVAL);
     ui_.Stack->setCurrentIndex(1);
 }
@@ -180,15 +186,21 @@ void MainWin::stop()
 {
     interrupted_ = true;
     if (client_thread_.joinable()) client_thread_.join();
+    parseStage_.reset();
 
     for (auto &[i, f] : id2channel_)
     {
+        f.sink.reset();
         f.decode.reset();
         if (f.decode_thread.joinable()) f.decode_thread.join();
-        f.rawfile.close();
-        f.tsfile.close();
+        f.rawfile.reset();
+        f.tsfile.reset();
+        f.player->setMailbox(nullptr);
     }
+    // 各通道的写盘线程会更新归档里的 ts 偏移, 等它们都退出后再关闭归档
+    archive_.reset();
     id2channel_.clear();
+    renderTimer_->stop();
     timer_->stop();
     time_ = 0;
     sfid_ = 0;
@@ -207,8 +219,77 @@ void MainWin::updateDisplay()
     }
 }
 
+void MainWin::renderFrames()
+{
+    for (auto &[i, chan] : id2channel_)
+    {
+        if (chan.mailbox && chan.mailbox->take()) chan.player->update();
+    }
+}
+
+void MainWin::updateStats()
+{
+    auto describe = [](const QString &name, auto &&status) {
+        return QStringLiteral("%1 %2/%3 丢%4").arg(name).arg(status.depth).arg(status.capacity).arg(status.dropped);
+    };
+    // 标签上只显示解析级, 各通道的明细放到提示里
+    QStringList details;
+    for (auto &[i, chan] : id2channel_)
+    {
+        if (!chan.sink) continue;
+        auto raw = chan.rawfile->status();
+        auto ts = chan.tsfile->status();
+        auto render = chan.mailbox->status();
+        details << describe(QStringLiteral("通道%1").arg(i), chan.sink->status()) +
+                       QStringLiteral(" 录制%1MB/s 积压%2K").arg(raw.mbps + ts.mbps, 0, 'f', 1).arg((raw.backlog + ts.backlog) >> 10) +
+                       (raw.failed + ts.failed ? QStringLiteral(" 写盘失败%1K").arg((raw.failed + ts.failed) >> 10) : QString()) +
+                       QStringLiteral(" 重同步%1").arg(chan.resyncs) +
+                       QStringLiteral(" 填充%1K 有效%2K").arg(chan.idleBytes >> 10).arg(chan.payloadBytes >> 10) +
+                       QStringLiteral(" 解码%1 显示%2 覆盖%3").arg(render.decoded).arg(render.displayed).arg(render.overwritten);
+    }
+    // 录制缓冲块写满之前数据不会交给写线程, 按落盘间隔让写入方把未满的块交出去
+    auto now = std::chrono::steady_clock::now();
+    if (form_.recordSyncMs > 0 && now - lastRecordFlush_ >= std::chrono::milliseconds(form_.recordSyncMs))
+    {
+        for (auto &[i, chan] : id2channel_)
+        {
+            if (chan.rawfile) chan.rawfile->requestFlush();
+            if (chan.tsfile) chan.tsfile->requestFlush();
+        }
+        lastRecordFlush_ = now;
+    }
+    auto sfid = sfidTracker_.status();
+    auto text = QStringLiteral("副帧 中断%1 丢%2 错%3").arg(sfid.gaps).arg(sfid.lost).arg(sfid.invalid);
+    if (auto reader = reader_.load())
+    {
+        auto recv = reader->status();
+        text = QStringLiteral("接收%1帧/s 重同步%2 ").arg(recv.msgs_per_sec, 0, 'f', 0).arg(recv.resyncs) +
+               (recv.lost ? QStringLiteral("共享内存丢%1 ").arg(recv.lost) : QString()) + " " + text;
+    }
+    if (parseStage_) text = describe(QStringLiteral("解析"), parseStage_->status()) + "  " + text;
+    ui_.Stats->setText(text);
+    ui_.Stats->setToolTip(details.join("\n"));
+}
+
+RecordOptions MainWin::recordOptions(const std::string &path) const
+{
+    RecordOptions opts;
+    opts.path = path;
+    opts.directIo = form_.recordDirectIo;
+    opts.rotateBytes = (uint64_t)form_.recordRotateMB << 20;
+    opts.rotateTime = std::chrono::minutes(form_.recordRotateMinutes);
+    opts.syncInterval = std::chrono::milliseconds(form_.recordSyncMs);
+    return opts;
+}
+
 // static std::ofstream ts0("www_recv_0.ts", std::ios::binary | std::ios::trunc);
 
+void MainWin::parseFrame(Frame &frame)
+{
+    frame.time = (yearBeginMs_ + frame.yearUs / 1000) / 1e3;
+    dispatchFrame(frame);
+}
+
 void MainWin::dispatchFrame(const Frame &frame)
 {
     if (form_.sfidIsBigEndian)
@@ -217,6 +298,12 @@ void MainWin::dispatchFrame(const Frame &frame)
         sfid_ = boost::endian::load_little_u16(frame.payload.data() + HEAD_OFFSET + form_.syncBytes);
     time_ = frame.time;
     receivedBytes_ += frame.payload.size();
+    // 超出范围的副帧号只计数(多半是范围没配对), 不据此重同步各通道
+    if (auto lost = sfidTracker_.update(sfid_); lost > 0)
+    {
+        markDiscontinuity(lost);
+    }
+    archive_->write(yearBeginMs_ * 1000 + (int64_t)frame.yearUs, sfid_, frame.payload.data(), frame.payload.size());
 
     switch (form_.videoMode)
     {
@@ -237,20 +324,12 @@ void MainWin::dispatchFrame(const Frame &frame)
 
 void MainWin::doDispatchColumn(const Frame &frame)
 {
-    split_frame_column_cross(frame, form_.videoChannelCount, form_.videoDataIsBigEndian, [this](auto &&idx, auto &&payload) {
-        if (!id2channel_.contains(idx)) return;
-
-        auto ptr = payload.data();
-        auto len = payload.size();
-        auto &&chan = id2channel_[idx];
-        chan.rawfile.write((char *)ptr, len);
-        if (!is_idle_frame(ptr))
-        {
-            chan.decode->push_bytes(ptr, len);
-            chan.tsfile.write((char *)ptr, len);
-        }
-        chan.payload.clear();
-    });
+    split_frame_column_cross(frame, form_.videoDataIsBigEndian, columns_);
+    for (auto i = 0; i < columns_.size(); ++i)
+    {
+        pushChunk(i, columns_[i].data(), columns_[i].size());
+        columns_[i].clear();
+    }
 }
 
 void MainWin::doDispatchColumnContinus(const Frame &frame)
@@ -259,27 +338,13 @@ void MainWin::doDispatchColumnContinus(const Frame &frame)
     auto ptr = (uint8_t *)frame.payload.data() + frame.offset;
     for (auto i = 0; i < form_.videoChannelCount; ++i)
     {
-        std::vector<uint8_t> line(ptr + i * bytesPerChannel, ptr + (i + 1) * bytesPerChannel);
-        auto &chan = id2channel_[i];
-        chan.rawfile.write((char *)line.data(), line.size());
-        if (!is_idle_frame(line.data()))
-        {
-            // if (id == 0)
-            {
-                chan.decode->push_bytes(line.data(), line.size());
-            }
-            chan.tsfile.write((char *)line.data(), line.size());
-        }
+        pushChunk(i, ptr + i * bytesPerChannel, bytesPerChannel);
     }
 }
 
 void MainWin::doDispatchRow(const Frame &frame)
 {
-    if (sfid_ < form_.videoReserved)
-    {
-        return;
-    }
-    int index = (sfid_ - form_.videoReserved) % form_.videoChannelCount;
+    int index = rowChannel(sfid_);
     if (index < 0 || !id2channel_.contains(index))
     {
         return;
@@ -290,29 +355,13 @@ void MainWin::doDispatchRow(const Frame &frame)
     {
         std::reverse(ptr, ptr + len);
     }
-
-    auto &chan = id2channel_.at(index);
-    chan.rawfile.write((char *)ptr, len);
-    if (!is_idle_frame(ptr))
-    {
-        // if (id == 0)
-        {
-            chan.decode->push_bytes(ptr, len);
-        }
-        chan.tsfile.write((char *)ptr, len);
-    }
-    // chan.payload.clear();
+    pushChunk(index, ptr, len);
 }
 
 void MainWin::doDispatchRowContinus(const Frame &frame)
 {
-    if (sfid_ < form_.videoReserved)
-    {
-        return;
-    }
-    auto rows_per_channel = (32 - form_.videoReserved) / form_.videoChannelCount;
-    int index = (sfid_ - form_.videoReserved) / rows_per_channel;
-    if (!id2channel_.contains(index))
+    int index = rowChannel(sfid_);
+    if (index < 0 || !id2channel_.contains(index))
     {
         return;
     }
@@ -322,29 +371,74 @@ void MainWin::doDispatchRowContinus(const Frame &frame)
     {
         std::reverse(ptr, ptr + len);
     }
+    pushChunk(index, ptr, len);
+}
 
-    auto &chan = id2channel_.at(index);
-    chan.rawfile.write((char *)ptr, len);
+int MainWin::rowChannel(int sfid) const
+{
+    if (sfid < form_.videoReserved || form_.videoChannelCount <= 0)
+    {
+        return -1;
+    }
+    if (form_.videoMode == 2)
+    {
+        return (sfid - form_.videoReserved) % form_.videoChannelCount;
+    }
+    auto rows_per_channel = (form_.sfidMax + 1 - form_.videoReserved) / form_.videoChannelCount;
+    return rows_per_channel > 0 ? (sfid - form_.videoReserved) / rows_per_channel : -1;
+}
 
-    if (is_idle_frame(ptr))
+void MainWin::markDiscontinuity(int lost)
+{
+    auto period = form_.sfidMax - form_.sfidMin + 1;
+    // 列模式每帧都带所有通道的数据; 行模式只影响丢失的行所属的通道
+    if (form_.videoMode < 2 || lost >= period)
     {
+        for (auto &[i, chan] : id2channel_)
+        {
+            chan.resync = true;
+        }
         return;
     }
+    for (auto k = 1; k <= lost; ++k)
+    {
+        auto sfid = form_.sfidMin + ((sfid_ - form_.sfidMin - k) % period + period) % period;
+        auto it = id2channel_.find(rowChannel(sfid));
+        if (it != id2channel_.end()) it->second.resync = true;
+    }
+}
 
-    chan.decode->push_bytes(ptr, len);
-    chan.tsfile.write((char *)ptr, len);
+void MainWin::pushChunk(size_t idx, const uint8_t *ptr, size_t len)
+{
+    auto it = id2channel_.find(idx);
+    if (it == id2channel_.end() || len == 0) return;
+    auto &chan = it->second;
+    // 入队失败同样丢了数据, 中断标记留给下一块
+    chan.resync = !chan.sink->push(std::make_shared<Chunk>(Chunk{ { ptr, ptr + len }, chan.resync }));
 }
 
-void MainWin::paintImage(int idx, const QImage &image)
+void MainWin::sinkChunk(VideoChannel &chan, const ChunkPtr &chunk)
 {
-    if (interrupted_) return;
-    // if (!tmc_) return;
-    // auto size = ui_.Player->size();
-    auto &chan = id2channel_[idx];
-    // chan.player->setPixmap(QPixmap::fromImage(image).scaled(chan.player->size()));
-    chan.player->setImage(image);
+    auto ptr = chunk->data.data();
+    auto len = chunk->data.size();
+    if (chunk->discontinuity)
+    {
+        chan.decode->discontinuity();
+        chan.resyncs++;
+    }
+    chan.rawfile->write(ptr, len);
+    // 原始文件保留全部数据, 解码和 ts 文件只要去掉填充后的部分
+    auto idle = idleFilter_.scan(ptr, len, [&chan](const uint8_t *data, size_t size) {
+        chan.decode->push_bytes((uint8_t *)data, size);
+        chan.tsfile->write(data, size);
+        chan.tsBytes += size;
+    });
+    archive_->setChannelOffset(chan.id, chan.tsBytes);
+    chan.idleBytes += idle;
+    chan.payloadBytes += len - idle;
 }
 
+
 void MainWin::saveCurrentConfig(const QString &path)
 {
     form_.receiveIp = ui_.IpEdit->text();
@@ -362,6 +456,14 @@ void MainWin::saveCurrentConfig(const QString &path)
     form_.forwardIp = ui_.ForwardIpEdit->text();
     form_.forwardPort = ui_.ForwardPortEdit->value();
     form_.parseCache = ui_.ParseCacheMode->currentIndex();
+    form_.recordRotateMB = ui_.RecordRotateMBEdit->value();
+    form_.recordRotateMinutes = ui_.RecordRotateMinutesEdit->value();
+    form_.recordDirectIo = ui_.RecordDirectIoEdit->isChecked();
+    form_.recordSyncMs = ui_.RecordSyncMsEdit->value();
+    form_.idlePatterns = ui_.IdlePatternsEdit->text();
+    form_.idleMinRun = ui_.IdleMinRunEdit->value();
+    form_.sfidMin = ui_.SfidMinEdit->value();
+    form_.sfidMax = qMax(ui_.SfidMaxEdit->value(), form_.sfidMin + 1);
 
     QFile file(path.isEmpty() ? CONFIG_FILE : path);
     if (file.open(QFile::WriteOnly | QFile::Truncate))
@@ -370,6 +472,8 @@ void MainWin::saveCurrentConfig(const QString &path)
         out << form_.receiveIp << form_.receivePort << form_.videoMode << form_.videoChannelCount << form_.videoReserved << form_.sfidIsBigEndian;
         out << form_.tmChannel << form_.tmTimeCode << form_.frameBytes << form_.syncBytes << form_.sfidBytes << form_.videoDataIsBigEndian << form_.forwardIp
             << form_.forwardPort << form_.parseCache;
+        out << form_.recordRotateMB << form_.recordRotateMinutes << form_.recordDirectIo << form_.recordSyncMs;
+        out << form_.idlePatterns << form_.idleMinRun << form_.sfidMin << form_.sfidMax;
         file.close();
     }
 }
@@ -383,6 +487,11 @@ void MainWin::loadSpecifiedConfig(const QString &path)
         in >> form_.receiveIp >> form_.receivePort >> form_.videoMode >> form_.videoChannelCount >> form_.videoReserved >> form_.sfidIsBigEndian;
         in >> form_.tmChannel >> form_.tmTimeCode >> form_.frameBytes >> form_.syncBytes >> form_.sfidBytes >> form_.videoDataIsBigEndian >> form_.forwardIp >>
             form_.forwardPort >> form_.parseCache;
+        if (!in.atEnd()) in >> form_.recordRotateMB >> form_.recordRotateMinutes >> form_.recordDirectIo >> form_.recordSyncMs;
+        if (!in.atEnd()) in >> form_.idlePatterns >> form_.idleMinRun;
+        //旧版本把带 0000 的默认填充字存进了配置, 换成现在的默认值
+        if (form_.idlePatterns == "0000,5555,FADE,DEAD") form_.idlePatterns = IdleFilter::DEFAULT_PATTERNS.data();
+        if (!in.atEnd()) in >> form_.sfidMin >> form_.sfidMax;
         file.close();
     }
 
@@ -401,28 +510,46 @@ void MainWin::loadSpecifiedConfig(const QString &path)
     ui_.ForwardIpEdit->setText(form_.forwardIp);
     ui_.ForwardPortEdit->setValue(form_.forwardPort);
     ui_.ParseCacheMode->setCurrentIndex(form_.parseCache);
+    ui_.RecordRotateMBEdit->setValue(form_.recordRotateMB);
+    ui_.RecordRotateMinutesEdit->setValue(form_.recordRotateMinutes);
+    ui_.RecordDirectIoEdit->setChecked(form_.recordDirectIo);
+    ui_.RecordSyncMsEdit->setValue(form_.recordSyncMs);
+    ui_.IdlePatternsEdit->setText(form_.idlePatterns);
+    ui_.IdleMinRunEdit->setValue(form_.idleMinRun);
+    ui_.SfidMinEdit->setValue(form_.sfidMin);
+    ui_.SfidMaxEdit->setValue(form_.sfidMax);
 }
 
 void MainWin::startReceiveTm(const std::string &ip, uint16_t port, uint16_t channel)
 {
     // std::ofstream file("sti_file_1.bin", std::ios::binary);
-    boost::asio::io_context io;
     auto offset = HEAD_OFFSET + form_.syncBytes + form_.sfidBytes + (form_.videoMode == 0 ? form_.videoReserved : 0);
-    sti_reader r(io, ip, port);
-    r.run(channel, 0, [this, offset](auto &&msg) {
-        if (msg.empty()) return !interrupted_;
-        auto ptr = (uint8_t *)msg.data();
-        auto time = (uint64_t)load_big_u32(ptr + 12) * 1e6 + load_big_u32(ptr + 16);
-        time = QDateTime({ QDate::currentDate().year(), 1, 1 }).addMSecs(time / 1e3).toMSecsSinceEpoch();
-        std::vector<uint8_t> payload(msg.begin() + 64, msg.end() - 4);
-        // file.write((char *)payload.data(), payload.size());
-        Frame video_frame{ frameCount_++, (double)time / 1e3, std::move(payload), offset };
-        // if (!is_idle_frame(video_frame))
+    // io 和 reader 放在一起, 统计拿着的最后一份引用释放时两者按顺序析构
+    struct Receiver
+    {
+        Receiver(const std::string &ip, uint16_t port)
+            : reader(io, ip, port)
         {
-            dispatchFrame(video_frame);
         }
+        boost::asio::io_context io;
+        sti_reader reader;
+    };
+    auto receiver = std::make_shared<Receiver>(ip, port);
+    reader_.store(std::shared_ptr<sti_reader>(receiver, &receiver->reader));
+    receiver->reader.run(channel, 0, [this, offset](std::span<const uint8_t> msg) {
+        if (msg.size() < 68) return !interrupted_;
+        // 接收线程只做拷贝和入队, 时间换算/拆分/写盘/解码都在后面的级里完成
+        auto ptr = msg.data();
+        auto frame = std::make_shared<Frame>();
+        frame->index = frameCount_++;
+        frame->yearUs = (uint64_t)load_big_u32(ptr + 12) * 1'000'000 + load_big_u32(ptr + 16);
+        frame->payload.assign(msg.begin() + 64, msg.end() - 4);
+        frame->offset = offset;
+        // file.write((char *)frame->payload.data(), frame->payload.size());
+        parseStage_->push(frame);
         return !interrupted_;
     });
     // file.close();
-    io.run();
+    reader_.store(nullptr);
+    receiver->io.run();
 }
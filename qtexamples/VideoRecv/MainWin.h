@@ -1,6 +1,12 @@
 ﻿#pragma once
 
 #include "Frame.h"
+#include "FrameMailbox.h"
+#include "IdleFilter.h"
+#include "PipeStage.h"
+#include "RecordWriter.h"
+#include "SfidTracker.h"
+#include "TmArchive.h"
 #include "ff_decoder.h"
 #include "ff_encoder.h"
 #include "ui_MainWin.h"
@@ -19,6 +25,7 @@
 #include <thread>
 
 struct SwsContext;
+class sti_reader;
 class QGridLayout;
 
 class Player : public QWidget
@@ -27,31 +34,48 @@ public:
     using QWidget::QWidget;
 
 public:
-    void setImage(const QImage &image)
+    void setMailbox(const FrameMailbox *mailbox)
     {
-        image_ = image;
+        mailbox_ = mailbox;
         update();
     }
 
 protected:
     void paintEvent(QPaintEvent *event) override
     {
+        if (!mailbox_) return;
         QPainter painter(this);
-        painter.drawImage(QRectF(rect()), image_);
+        painter.drawImage(QRectF(rect()), mailbox_->front());
     }
 
 private:
-    QImage image_;
+    const FrameMailbox *mailbox_{ nullptr };
 };
 
+using FramePtr = std::shared_ptr<Frame>;
+
+struct Chunk
+{
+    std::vector<uint8_t> data;
+    bool discontinuity{ false };  // 与上一块之间丢了数据, 解码器需要重新同步
+};
+using ChunkPtr = std::shared_ptr<Chunk>;
+
 struct VideoChannel
 {
+    int id{ 0 };
     Player *player;
+    std::unique_ptr<FrameMailbox> mailbox{ nullptr };  // 解码 -> 显示
     std::unique_ptr<ff_decoder> decode{ nullptr };
     std::thread decode_thread;
-    std::vector<uint8_t> payload;
-    std::ofstream rawfile;
-    std::ofstream tsfile;
+    std::unique_ptr<PipeStage<ChunkPtr>> sink{ nullptr };  // 解析级 -> 解码/录制/转发
+    std::unique_ptr<RecordWriter> rawfile{ nullptr };
+    std::unique_ptr<RecordWriter> tsfile{ nullptr };
+    uint64_t tsBytes{ 0 };                    // 已交给 tsfile 的字节数, 只在录制线程使用
+    std::atomic<uint64_t> idleBytes{ 0 };     // 被丢弃的填充字节
+    std::atomic<uint64_t> payloadBytes{ 0 };  // 送去解码/录制的字节
+    std::atomic<uint64_t> resyncs{ 0 };       // 解码器重新同步的次数
+    bool resync{ false };                     // 下一块带上中断标记, 只在解析线程使用
     // std::unique_ptr<ff_encoder> fwd{ nullptr };
 };
 
@@ -73,6 +97,17 @@ struct VideoRecvConfig
     int forwardPort{ 32100 };
 
     int parseCache{ 320 };
+
+    int recordRotateMB{ 0 };       // 录制文件按大小切分, 0 不切分
+    int recordRotateMinutes{ 0 };  // 录制文件按时间切分, 0 不切分
+    bool recordDirectIo{ false };
+    int recordSyncMs{ 0 };  // 0 切分/停止时落盘, <0 不主动落盘, >0 按间隔落盘
+
+    QString idlePatterns{ IdleFilter::DEFAULT_PATTERNS.data() };  // 十六进制填充字, 逗号分隔
+    int idleMinRun{ 64 };  // 连续填充不少于这么多字节才丢弃
+
+    int sfidMin{ 0 };  // 副帧号循环范围
+    int sfidMax{ 31 };
 };
 
 class MainWin : public QFrame
@@ -90,24 +125,31 @@ private:
     void start();
     void stop();
     void updateDisplay();
+    void parseFrame(Frame &);
     void dispatchFrame(const Frame &);
     void doDispatchColumn(const Frame &);
     void doDispatchColumnContinus(const Frame &);
     void doDispatchRow(const Frame &);
     void doDispatchRowContinus(const Frame &);
-    void paintImage(int idx, const QImage &image);
+    int rowChannel(int sfid) const;
+    void markDiscontinuity(int lost);
+    void pushChunk(size_t idx, const uint8_t *ptr, size_t len);
+    void sinkChunk(VideoChannel &chan, const ChunkPtr &chunk);
+    void renderFrames();
+    void updateStats();
+    RecordOptions recordOptions(const std::string &path) const;
     void saveCurrentConfig(const QString &path = "");
     void loadSpecifiedConfig(const QString &path = "");
     void startReceiveTm(const std::string &ip, uint16_t port, uint16_t channel);
 
 signals:
     void statusChanged(const QString &);
-    void imageReceived(int idx, const QImage &image);
 
 private:
     Ui::MainWin ui_;
     QGridLayout *playerLayout_{ nullptr };
     QTimer *timer_;
+    QTimer *renderTimer_;  // 按屏幕刷新率从信箱取帧
     QList<std::function<void()>> tasks_;
 
     std::atomic<double> time_{ 0 };
@@ -118,6 +160,14 @@ private:
     bool resizing_{ false };
 
     std::map<size_t, VideoChannel> id2channel_;
+    std::vector<std::vector<uint8_t>> columns_;  // 列模式下每帧各通道的数据
+    IdleFilter idleFilter_;
+    SfidTracker sfidTracker_;
+    std::unique_ptr<PipeStage<FramePtr>> parseStage_{ nullptr };  // 接收 -> 解析/拆分
+    std::unique_ptr<TmArchiveWriter> archive_{ nullptr };         // 遥测帧按时间归档, 在解析线程写入
+    std::atomic<std::shared_ptr<sti_reader>> reader_;              // 接收线程运行期间有效, 统计时取一份引用
+    qint64 yearBeginMs_{ 0 };
+    std::chrono::steady_clock::time_point lastRecordFlush_;
     std::thread client_thread_;
 
     VideoRecvConfig form_;
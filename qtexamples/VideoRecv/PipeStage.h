@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include "sti/lockfree_spsc_queue.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+
+// 流水线中的一级: 上一级只负责入队, 队列满时丢弃并计数, 不会被本级的处理速度阻塞
+template <class T>
+class PipeStage
+{
+public:
+    struct Status
+    {
+        size_t capacity;
+        size_t depth;
+        size_t dropped;
+    };
+
+public:
+    PipeStage(size_t capacity)
+        : queue_(capacity)
+    {
+    }
+
+    ~PipeStage()
+    {
+        stop();
+    }
+
+public:
+    void start(std::function<void(T &)> func)
+    {
+        if (running_) return;
+        running_ = true;
+        thread_ = std::thread([this, func = std::move(func)] {
+            while (running_)
+            {
+                // 直接在队列里处理, 处理完再释放, 不再每次唤醒都拷贝出一个 vector
+                auto items = queue_.read_span();
+                for (auto &&it : items)
+                {
+                    func(it);
+                }
+                queue_.consume(items.size());
+            }
+        });
+    }
+
+    void stop()
+    {
+        if (!running_) return;
+        running_ = false;
+        queue_.quit();
+        if (thread_.joinable()) thread_.join();
+        queue_.reset();
+    }
+
+    bool push(const T &t)
+    {
+        if (queue_.push(t)) return true;
+        dropped_++;
+        return false;
+    }
+
+    Status status() const
+    {
+        return { queue_.capacity(), queue_.used_size(), dropped_ };
+    }
+
+private:
+    lockfree_spsc_queue<T> queue_;
+    std::atomic<size_t> dropped_{ 0 };
+    std::atomic<bool> running_{ false };
+    std::thread thread_;
+};
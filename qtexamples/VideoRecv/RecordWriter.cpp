@@ -0,0 +1,289 @@
+﻿#include "RecordWriter.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace std::chrono;
+using namespace std::literals;
+
+constexpr static size_t SECTOR_BYTES = 4096;
+
+static size_t align_up(size_t n)
+{
+    return (n + SECTOR_BYTES - 1) / SECTOR_BYTES * SECTOR_BYTES;
+}
+
+struct RecordWriter::File
+{
+#ifdef _WIN32
+    HANDLE handle{ INVALID_HANDLE_VALUE };
+#else
+    int fd{ -1 };
+#endif
+    bool direct{ false };
+
+    bool open(const std::string &path, bool directIo)
+    {
+#ifdef _WIN32
+        DWORD flags = FILE_ATTRIBUTE_NORMAL | (directIo ? FILE_FLAG_NO_BUFFERING : 0);
+        handle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, flags, nullptr);
+        direct = directIo;
+        return handle != INVALID_HANDLE_VALUE;
+#else
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    #ifdef O_DIRECT
+        if (directIo)
+        {
+            fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            direct = fd >= 0;
+        }
+    #endif
+        // 文件系统不支持 O_DIRECT 时退回普通写
+        if (fd < 0) fd = ::open(path.c_str(), flags, 0644);
+        return fd >= 0;
+#endif
+    }
+
+    bool write(const uint8_t *data, size_t len)
+    {
+        while (len > 0)
+        {
+#ifdef _WIN32
+            DWORD n = 0;
+            if (!WriteFile(handle, data, (DWORD)std::min<size_t>(len, 1 << 30), &n, nullptr)) return false;
+#else
+            auto n = ::write(fd, data, len);
+            if (n <= 0) return false;
+#endif
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    void sync()
+    {
+#ifdef _WIN32
+        FlushFileBuffers(handle);
+#else
+        ::fsync(fd);
+#endif
+    }
+
+    // 直写模式下最后一块按扇区补齐写入, 关闭前截断回真实大小
+    void close(uint64_t size, bool padded)
+    {
+#ifdef _WIN32
+        if (padded)
+        {
+            LARGE_INTEGER pos;
+            pos.QuadPart = (LONGLONG)size;
+            SetFilePointerEx(handle, pos, nullptr, FILE_BEGIN);
+            SetEndOfFile(handle);
+        }
+        CloseHandle(handle);
+#else
+        if (padded) (void)::ftruncate(fd, (off_t)size);
+        ::close(fd);
+#endif
+    }
+};
+
+RecordWriter::RecordWriter(RecordOptions opts)
+    : opts_(std::move(opts))
+{
+    blockBytes_ = align_up(std::max<size_t>(opts_.bufferBytes, SECTOR_BYTES));
+    for (size_t i = 0; i < std::max<size_t>(opts_.bufferCount, 2); ++i)
+    {
+        blocks_.push_back(static_cast<uint8_t *>(::operator new(blockBytes_, std::align_val_t{ SECTOR_BYTES })));
+    }
+    current_.data = blocks_[0];
+    free_.assign(blocks_.begin() + 1, blocks_.end());
+    thread_ = std::thread(&RecordWriter::run, this);
+}
+
+RecordWriter::~RecordWriter()
+{
+    {
+        std::scoped_lock lock(mutex_);
+        if (current_.len > 0) full_.push_back(current_);
+        current_ = {};
+        quit_ = true;
+    }
+    fullCond_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    for (auto b : blocks_)
+    {
+        ::operator delete(b, std::align_val_t{ SECTOR_BYTES });
+    }
+}
+
+void RecordWriter::write(const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        auto n = std::min(len, blockBytes_ - current_.len);
+        memcpy(current_.data + current_.len, data, n);
+        current_.len += n;
+        backlog_ += n;
+        data += n;
+        len -= n;
+        if (current_.len == blockBytes_) handOff(false);
+    }
+    if (flushRequested_.load(std::memory_order_relaxed) && flushRequested_.exchange(false)) flush();
+}
+
+void RecordWriter::flush()
+{
+    if (current_.len > 0) handOff(true);
+}
+
+void RecordWriter::requestFlush()
+{
+    flushRequested_ = true;
+}
+
+RecordWriter::Status RecordWriter::status() const
+{
+    return { written_, failed_, backlog_, stalls_, mbps_, files_ };
+}
+
+void RecordWriter::handOff(bool partial)
+{
+    auto out = current_;
+    // 直写模式只能提交整扇区, 不足一个扇区的尾巴留到下一块
+    size_t keep = (partial && opts_.directIo) ? out.len % SECTOR_BYTES : 0;
+    out.len -= keep;
+    if (out.len == 0) return;
+
+    std::unique_lock lock(mutex_);
+    if (free_.empty())
+    {
+        stalls_++;
+        freeCond_.wait(lock, [this] {
+            return !free_.empty();
+        });
+    }
+    auto next = free_.back();
+    free_.pop_back();
+    memcpy(next, out.data + out.len, keep);
+    current_ = { next, keep };
+    full_.push_back(out);
+    fullCond_.notify_one();
+}
+
+void RecordWriter::run()
+{
+    openNext();
+    auto sampleTime = steady_clock::now();
+    uint64_t sampleBytes = 0;
+    bool padded = false;
+    while (true)
+    {
+        Block block;
+        {
+            std::unique_lock lock(mutex_);
+            fullCond_.wait_for(lock, 100ms, [this] {
+                return quit_ || !full_.empty();
+            });
+            if (!full_.empty())
+            {
+                block = full_.front();
+                full_.pop_front();
+            }
+            else if (quit_)
+            {
+                break;
+            }
+        }
+
+        auto now = steady_clock::now();
+        if (block.data)
+        {
+            bool rotate = (opts_.rotateBytes > 0 && fileBytes_ >= opts_.rotateBytes) ||
+                          (opts_.rotateTime.count() > 0 && fileBytes_ > 0 && now - fileOpened_ >= opts_.rotateTime);
+            if (rotate || padded)
+            {
+                closeCurrent();
+                openNext();
+                padded = false;
+            }
+            bool ok = false;
+            if (file_)
+            {
+                auto io = file_->direct ? align_up(block.len) : block.len;
+                memset(block.data + block.len, 0, io - block.len);
+                ok = file_->write(block.data, io);
+                padded = io != block.len;
+            }
+            if (ok)
+            {
+                fileBytes_ += block.len;
+                written_ += block.len;
+                failing_ = false;
+            }
+            else
+            {
+                // 磁盘满等情况下每块都会失败, 只在刚出错时打印一次
+                if (!failing_) printf("[RecordWriter] write %s failed, dropping data until a write succeeds\n", opts_.path.c_str());
+                failing_ = true;
+                failed_ += block.len;
+            }
+            backlog_ -= block.len;
+
+            std::scoped_lock lock(mutex_);
+            free_.push_back(block.data);
+            freeCond_.notify_one();
+        }
+
+        if (file_ && opts_.syncInterval.count() > 0 && now - lastSync_ >= opts_.syncInterval)
+        {
+            file_->sync();
+            lastSync_ = now;
+        }
+        if (now - sampleTime >= 1s)
+        {
+            mbps_ = (written_ - sampleBytes) / duration<double>(now - sampleTime).count() / 1e6;
+            sampleBytes = written_;
+            sampleTime = now;
+        }
+    }
+    closeCurrent();
+}
+
+bool RecordWriter::openNext()
+{
+    std::filesystem::path path(opts_.path);
+    if (files_ > 0)
+    {
+        path.replace_filename(std::format("{}_{:04d}{}", path.stem().string(), files_.load(), path.extension().string()));
+    }
+
+    auto file = std::make_unique<File>();
+    if (!file->open(path.string(), opts_.directIo))
+    {
+        if (!failing_) printf("[RecordWriter] open %s failed\n", path.string().c_str());
+        failing_ = true;
+        return false;
+    }
+    file_ = std::move(file);
+    fileBytes_ = 0;
+    fileOpened_ = lastSync_ = steady_clock::now();
+    files_++;
+    return true;
+}
+
+void RecordWriter::closeCurrent()
+{
+    if (!file_) return;
+    if (opts_.syncInterval.count() >= 0) file_->sync();
+    file_->close(fileBytes_, file_->direct && fileBytes_ % SECTOR_BYTES != 0);
+    file_.reset();
+}
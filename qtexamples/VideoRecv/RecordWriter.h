@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct RecordOptions
+{
+    std::string path;                    // 文件名, 切分后的文件为 name_0001.ext
+    size_t bufferBytes{ 4 << 20 };       // 每块缓冲大小, 向上对齐到 4K
+    size_t bufferCount{ 2 };             // 缓冲块个数, 默认双缓冲
+    bool directIo{ false };              // 绕过系统缓存(O_DIRECT / FILE_FLAG_NO_BUFFERING)
+    uint64_t rotateBytes{ 0 };           // 按大小切分, 0 不切分
+    std::chrono::seconds rotateTime{ 0 };  // 按时间切分, 0 不切分
+    std::chrono::milliseconds syncInterval{ 0 };  // 0: 只在切分/关闭时落盘, <0: 从不主动落盘, >0: 按间隔落盘
+};
+
+// 录制文件写入器: 调用线程只把数据拷贝进对齐的缓冲块, 写盘/切分/落盘都在独立的写线程里完成
+class RecordWriter
+{
+public:
+    struct Status
+    {
+        uint64_t written;  // 已写入磁盘的字节数
+        uint64_t failed;   // 写盘失败或文件没打开而丢弃的字节数
+        uint64_t backlog;  // 尚未写盘的字节数
+        uint64_t stalls;   // 缓冲块用尽时调用线程等待的次数
+        double mbps;       // 最近一秒的写盘速率, MB/s
+        int files;         // 已打开过的文件个数
+    };
+
+public:
+    RecordWriter(RecordOptions opts);
+    ~RecordWriter();
+
+public:
+    void write(const uint8_t *data, size_t len);
+    /** 把当前未写满的缓冲块交给写线程, 只能在调用 write 的线程调用 */
+    void flush();
+    /** 任意线程调用, 下一次 write 结束时 flush; 写得慢的文件靠它按落盘间隔落盘, 不必等缓冲块写满 */
+    void requestFlush();
+    Status status() const;
+
+private:
+    struct Block
+    {
+        uint8_t *data{ nullptr };
+        size_t len{ 0 };
+    };
+
+    void handOff(bool partial);
+    void run();
+    bool openNext();
+    void closeCurrent();
+
+private:
+    RecordOptions opts_;
+    size_t blockBytes_{ 0 };
+    std::vector<uint8_t *> blocks_;
+    Block current_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable fullCond_;
+    std::condition_variable freeCond_;
+    std::deque<Block> full_;
+    std::vector<uint8_t *> free_;
+    bool quit_{ false };
+    std::atomic<bool> flushRequested_{ false };
+
+    struct File;
+    std::unique_ptr<File> file_;
+    uint64_t fileBytes_{ 0 };
+    std::chrono::steady_clock::time_point fileOpened_;
+    std::chrono::steady_clock::time_point lastSync_;
+    bool failing_{ false };  // 出错后只打印一次, 直到再次写成功
+
+    std::atomic<uint64_t> written_{ 0 };
+    std::atomic<uint64_t> failed_{ 0 };
+    std::atomic<uint64_t> backlog_{ 0 };
+    std::atomic<uint64_t> stalls_{ 0 };
+    std::atomic<double> mbps_{ 0 };
+    std::atomic<int> files_{ 0 };
+    std::thread thread_;
+};
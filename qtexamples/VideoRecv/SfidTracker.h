@@ -0,0 +1,83 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// 副帧号连续性检查: 副帧号在 [min, max] 内循环递增, 不是期望值时记一次中断并估算丢失的帧数
+class SfidTracker
+{
+public:
+    struct Status
+    {
+        uint64_t frames;  // 收到的帧数
+        uint64_t gaps;    // 中断次数
+        uint64_t lost;    // 估算丢失的帧数
+        uint64_t invalid;  // 超出范围的副帧号
+    };
+
+public:
+    SfidTracker(int min = 0, int max = 31)
+        : min_(min)
+        , max_(max > min ? max : min + 1)
+    {
+    }
+
+public:
+    /**
+     * 检查当前副帧号
+     * @return 与上一帧之间丢失的帧数, 0 表示连续, -1 表示副帧号超出范围
+     */
+    int update(int sfid)
+    {
+        frames_++;
+        if (sfid < min_ || sfid > max_)
+        {
+            invalid_++;
+            gaps_++;
+            last_ = -1;
+            return -1;
+        }
+
+        auto last = last_;
+        last_ = sfid;
+        if (last < 0) return 0;
+
+        auto period = max_ - min_ + 1;
+        auto lost = (sfid - next(last) + period) % period;
+        if (lost > 0)
+        {
+            gaps_++;
+            lost_ += lost;
+        }
+        return lost;
+    }
+
+    /** sfid 之后的期望副帧号 */
+    int next(int sfid) const
+    {
+        return sfid >= max_ ? min_ : sfid + 1;
+    }
+
+    void reset(int min, int max)
+    {
+        min_ = min;
+        max_ = max > min ? max : min + 1;
+        last_ = -1;
+        frames_ = gaps_ = lost_ = invalid_ = 0;
+    }
+
+    Status status() const
+    {
+        return { frames_, gaps_, lost_, invalid_ };
+    }
+
+private:
+    int min_;
+    int max_;
+    int last_{ -1 };  // 只在解析线程使用
+
+    std::atomic<uint64_t> frames_{ 0 };
+    std::atomic<uint64_t> gaps_{ 0 };
+    std::atomic<uint64_t> lost_{ 0 };
+    std::atomic<uint64_t> invalid_{ 0 };
+};
@@ -1,28 +1,87 @@
 #pragma once
 
 #include "Frame.h"
-#include <algorithm>
-#include <functional>
-#include <iterator>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SPLIT_FRAME_SSE2 1
+#endif
 
-static void split_frame_column_cross(const Frame &frame, size_t channels, bool bigendian, std::function<void(size_t, std::vector<uint8_t>)> func)
+// 按字(2 字节)轮流分给各通道: 第 i 个字写到 dst[i % channels] + i / channels * 2, bigendian 为 false 时字内交换字节
+// 1 路(只交换字节)、2、4 路用 SSE2 一次处理 16 个字, 其余路数和尾部逐字拷贝
+static void deinterleave_words(const uint8_t *src, size_t words, size_t channels, bool bigendian, uint8_t *const *dst)
 {
-    int index = 0;
-    auto bytesPerChannel = (frame.payload.size() - frame.offset) / channels;
-
-    auto ptr = (char *)frame.payload.data();
-    for (auto i = frame.offset; i < frame.payload.size(); i += 2)
+    size_t i = 0;
+#ifdef SPLIT_FRAME_SSE2
+    auto swap = [bigendian](__m128i v) {
+        return bigendian ? v : _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    };
+    if (channels == 1)
+    {
+        for (; i + 8 <= words; i += 8)
+        {
+            _mm_storeu_si128((__m128i *)(dst[0] + i * 2), swap(_mm_loadu_si128((const __m128i *)(src + i * 2))));
+        }
+    }
+    else if (channels == 2)
+    {
+        for (; i + 16 <= words; i += 16)
+        {
+            // 每 32 位里的两个字分开: 偶数字到低 64 位, 奇数字到高 64 位
+            auto a = _mm_loadu_si128((const __m128i *)(src + i * 2));
+            auto b = _mm_loadu_si128((const __m128i *)(src + i * 2 + 16));
+            a = _mm_shuffle_epi32(_mm_shufflehi_epi16(_mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+            b = _mm_shuffle_epi32(_mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128((__m128i *)(dst[0] + i), swap(_mm_unpacklo_epi64(a, b)));
+            _mm_storeu_si128((__m128i *)(dst[1] + i), swap(_mm_unpackhi_epi64(a, b)));
+        }
+    }
+    else if (channels == 4)
     {
-        auto index = ((i - frame.offset) / 2) % channels;
-        std::vector<uint8_t> payload;
-        if (bigendian)
+        for (; i + 16 <= words; i += 16)
         {
-            std::copy(ptr + i, ptr + i + 2, std::back_inserter(payload));
+            // 16 位 4x4 转置的前两步, 每个通道得到 4 个字
+            auto a = _mm_loadu_si128((const __m128i *)(src + i * 2));
+            auto b = _mm_loadu_si128((const __m128i *)(src + i * 2 + 16));
+            auto t0 = _mm_unpacklo_epi16(a, b);
+            auto t1 = _mm_unpackhi_epi16(a, b);
+            auto u0 = swap(_mm_unpacklo_epi16(t0, t1));
+            auto u1 = swap(_mm_unpackhi_epi16(t0, t1));
+            auto pos = i / 2;
+            _mm_storel_epi64((__m128i *)(dst[0] + pos), u0);
+            _mm_storel_epi64((__m128i *)(dst[1] + pos), _mm_unpackhi_epi64(u0, u0));
+            _mm_storel_epi64((__m128i *)(dst[2] + pos), u1);
+            _mm_storel_epi64((__m128i *)(dst[3] + pos), _mm_unpackhi_epi64(u1, u1));
         }
-        else
+    }
+#endif
+    for (size_t c = i % channels, pos = i / channels * 2; i < words; ++i)
+    {
+        auto out = dst[c] + pos;
+        auto in = src + i * 2;
+        out[0] = bigendian ? in[0] : in[1];
+        out[1] = bigendian ? in[1] : in[0];
+        if (++c == channels)
         {
-            std::reverse_copy(ptr + i, ptr + i + 2, std::back_inserter(payload));
+            c = 0;
+            pos += 2;
         }
-        func(index, std::move(payload));
     }
 }
+
+// 按列拆分整帧, 每个通道的数据追加到 outputs[通道] 末尾
+static void split_frame_column_cross(const Frame &frame, bool bigendian, std::vector<std::vector<uint8_t>> &outputs)
+{
+    auto channels = outputs.size();
+    if (channels == 0 || frame.payload.size() <= frame.offset) return;
+    auto words = (frame.payload.size() - frame.offset) / 2;
+    std::vector<uint8_t *> dst(channels);
+    for (size_t c = 0; c < channels; ++c)
+    {
+        auto &out = outputs[c];
+        auto old = out.size();
+        out.resize(old + (words + channels - 1 - c) / channels * 2);
+        dst[c] = out.data() + old;
+    }
+    deinterleave_words(frame.payload.data() + frame.offset, words, channels, bigendian, dst.data());
+}
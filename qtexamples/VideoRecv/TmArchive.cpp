@@ -0,0 +1,232 @@
+﻿#include "TmArchive.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+constexpr static size_t CHUNK_ALIGN = 4096;
+
+TmArchiveWriter::TmArchiveWriter(RecordOptions opts, size_t chunkBytes)
+    : chunkBytes_((std::max<size_t>(chunkBytes, CHUNK_ALIGN) + CHUNK_ALIGN - 1) / CHUNK_ALIGN * CHUNK_ALIGN)
+    , chunk_(chunkBytes_)
+{
+    auto base = opts.path;
+    opts.rotateBytes = 0;
+    opts.rotateTime = std::chrono::seconds(0);
+    opts.path = base + ".tma";
+    data_ = std::make_unique<RecordWriter>(opts);
+
+    // 索引很小, 每块写一条并立即交给写线程, 不走直写
+    RecordOptions indexOpts;
+    indexOpts.path = base + ".tmi";
+    indexOpts.bufferBytes = 64 << 10;
+    indexOpts.syncInterval = opts.syncInterval;
+    indexFile_ = std::make_unique<RecordWriter>(indexOpts);
+
+    TmArchiveHeader header;
+    header.chunkBytes = (uint32_t)chunkBytes_;
+    header.createdUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    indexFile_->write((const uint8_t *)&header, sizeof(header));
+    indexFile_->flush();
+}
+
+TmArchiveWriter::~TmArchiveWriter()
+{
+    finishChunk();
+    data_.reset();
+    indexFile_.reset();
+}
+
+bool TmArchiveWriter::write(int64_t timeUs, uint16_t sfid, const uint8_t *data, size_t len)
+{
+    auto bytes = sizeof(TmArchiveRecord) + (len + 7) / 8 * 8;
+    if (len == 0 || bytes > chunkBytes_)
+    {
+        rejected_++;
+        return false;
+    }
+    if (used_ + bytes > chunkBytes_) finishChunk();
+    if (used_ == 0)
+    {
+        index_ = {};
+        index_.firstUs = timeUs;
+        index_.offset = offset_;
+        index_.firstSfid = sfid;
+        for (int i = 0; i < TM_ARCHIVE_CHANNELS; ++i)
+        {
+            index_.tsOffset[i] = tsBytes_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    TmArchiveRecord rec{ timeUs, (uint32_t)len, sfid, 0 };
+    memcpy(chunk_.data() + used_, &rec, sizeof(rec));
+    memcpy(chunk_.data() + used_ + sizeof(rec), data, len);
+    memset(chunk_.data() + used_ + sizeof(rec) + len, 0, bytes - sizeof(rec) - len);
+    used_ += bytes;
+    index_.lastUs = std::max(index_.lastUs, timeUs);
+    index_.frames++;
+    frames_++;
+    return true;
+}
+
+void TmArchiveWriter::setChannelOffset(int channel, uint64_t bytes)
+{
+    if (channel >= 0 && channel < TM_ARCHIVE_CHANNELS)
+    {
+        tsBytes_[channel].store(bytes, std::memory_order_relaxed);
+    }
+    else if (!channelWarned_.exchange(true))
+    {
+        //索引格式固定 TM_ARCHIVE_CHANNELS 个通道, 之后的通道按时间定位时只能从 ts 文件开头解码
+        printf("[TmArchiveWriter] channel %d is not indexed, the archive keeps ts offsets of %d channels\n", channel, TM_ARCHIVE_CHANNELS);
+    }
+}
+
+void TmArchiveWriter::flush()
+{
+    finishChunk();
+}
+
+TmArchiveWriter::Status TmArchiveWriter::status() const
+{
+    return { frames_, chunks_, rejected_ };
+}
+
+void TmArchiveWriter::finishChunk()
+{
+    if (used_ == 0) return;
+    // 块按固定大小落盘, 剩余部分清零, 读取时遇到长度 0 的记录即结束
+    memset(chunk_.data() + used_, 0, chunkBytes_ - used_);
+    data_->write(chunk_.data(), chunkBytes_);
+    index_.bytes = (uint32_t)used_;
+    indexFile_->write((const uint8_t *)&index_, sizeof(index_));
+    indexFile_->flush();
+    offset_ += chunkBytes_;
+    used_ = 0;
+    chunks_++;
+}
+
+struct TmArchiveReader::Mapping
+{
+    const uint8_t *data{ nullptr };
+    size_t size{ 0 };
+#ifdef _WIN32
+    HANDLE file{ INVALID_HANDLE_VALUE };
+    HANDLE mapping{ nullptr };
+#endif
+
+    bool open(const std::string &path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER len;
+        if (!GetFileSizeEx(file, &len) || len.QuadPart == 0) return false;
+        size = (size_t)len.QuadPart;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return false;
+        data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+#else
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        size = (size_t)st.st_size;
+        auto ptr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED) return false;
+        data = (const uint8_t *)ptr;
+        return true;
+#endif
+    }
+
+    ~Mapping()
+    {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) ::munmap((void *)data, size);
+#endif
+    }
+};
+
+TmArchiveReader::TmArchiveReader() = default;
+
+TmArchiveReader::~TmArchiveReader()
+{
+    close();
+}
+
+bool TmArchiveReader::open(const std::string &path)
+{
+    close();
+    auto data = std::make_unique<Mapping>();
+    auto index = std::make_unique<Mapping>();
+    if (!data->open(path + ".tma") || !index->open(path + ".tmi"))
+    {
+        printf("[TmArchiveReader] open %s failed\n", path.c_str());
+        return false;
+    }
+
+    TmArchiveHeader header;
+    if (index->size < sizeof(header)) return false;
+    memcpy(&header, index->data, sizeof(header));
+    if (header.magic != TM_ARCHIVE_MAGIC || header.version != TM_ARCHIVE_VERSION || header.channels != TM_ARCHIVE_CHANNELS)
+    {
+        printf("[TmArchiveReader] %s is not a telemetry archive\n", path.c_str());
+        return false;
+    }
+
+    // 正在写的归档: 索引可能领先于数据, 只保留数据已经完整落盘的块
+    auto entries = (const TmArchiveIndex *)(index->data + sizeof(header));
+    auto count = (index->size - sizeof(header)) / sizeof(TmArchiveIndex);
+    while (count > 0 && entries[count - 1].offset + entries[count - 1].bytes > data->size)
+    {
+        count--;
+    }
+
+    data_ = { data->data, data->size };
+    index_ = { entries, count };
+    dataMap_ = std::move(data);
+    indexMap_ = std::move(index);
+    return true;
+}
+
+void TmArchiveReader::close()
+{
+    data_ = {};
+    index_ = {};
+    dataMap_.reset();
+    indexMap_.reset();
+}
+
+size_t TmArchiveReader::seek(int64_t timeUs) const
+{
+    // 块按写入顺序排列, 时间单调时 lastUs 有序
+    auto it = std::lower_bound(index_.begin(), index_.end(), timeUs, [](const TmArchiveIndex &idx, int64_t t) {
+        return idx.lastUs < t;
+    });
+    return it - index_.begin();
+}
+
+uint64_t TmArchiveReader::tsOffset(int channel, int64_t timeUs) const
+{
+    if (index_.empty() || channel < 0 || channel >= TM_ARCHIVE_CHANNELS) return 0;
+    auto i = std::min(seek(timeUs), index_.size() - 1);
+    return index_[i].tsOffset[channel];
+}
@@ -0,0 +1,167 @@
+﻿#pragma once
+
+#include "RecordWriter.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+/* 遥测帧归档: name.tma 存帧, name.tmi 存索引
+ * .tma 由固定大小的块组成, 块内依次是 [TmArchiveRecord][帧数据, 8 字节对齐], 帧不跨块
+ * .tmi 是 [TmArchiveHeader][TmArchiveIndex]..., 每写完一块追加一条, 只引用已经交给写线程的块
+ */
+constexpr uint32_t TM_ARCHIVE_MAGIC = 0x49414D54;  // "TMAI"
+constexpr uint32_t TM_ARCHIVE_VERSION = 1;
+constexpr int TM_ARCHIVE_CHANNELS = 8;
+
+struct TmArchiveHeader
+{
+    uint32_t magic{ TM_ARCHIVE_MAGIC };
+    uint32_t version{ TM_ARCHIVE_VERSION };
+    uint32_t chunkBytes{ 0 };
+    uint32_t channels{ TM_ARCHIVE_CHANNELS };
+    int64_t createdUs{ 0 };  // 创建时间, 1970 起的微秒
+    uint64_t reserved{ 0 };
+};
+
+struct TmArchiveIndex
+{
+    int64_t firstUs;        // 块内第一帧的时间, 1970 起的微秒
+    int64_t lastUs;         // 块内最后一帧的时间
+    uint64_t offset;        // 块在 .tma 中的偏移
+    uint32_t bytes;         // 块内有效字节数
+    uint32_t frames;        // 块内帧数
+    uint32_t firstSfid;     // 块内第一帧的副帧号
+    uint32_t reserved;
+    uint64_t tsOffset[TM_ARCHIVE_CHANNELS];  // 块开始时各通道 ts 文件已写的字节数
+};
+
+struct TmArchiveRecord
+{
+    int64_t timeUs;
+    uint32_t len;  // 帧长, 0 表示块内没有更多的帧
+    uint16_t sfid;
+    uint16_t flags;
+};
+
+// 写入: 只在一个线程调用 write, 通道偏移可以在任意线程更新
+class TmArchiveWriter
+{
+public:
+    struct Status
+    {
+        uint64_t frames;
+        uint64_t chunks;
+        uint64_t rejected;  // 超过块大小的帧
+    };
+
+public:
+    /** opts.path 不带扩展名; 归档按偏移寻址, 不做切分 */
+    TmArchiveWriter(RecordOptions opts, size_t chunkBytes = 1 << 20);
+    ~TmArchiveWriter();
+
+public:
+    bool write(int64_t timeUs, uint16_t sfid, const uint8_t *data, size_t len);
+    /** 通道 ts 文件当前的字节数, 记录到下一块的索引里; 超出 TM_ARCHIVE_CHANNELS 的通道不记录, 第一次时打印警告 */
+    void setChannelOffset(int channel, uint64_t bytes);
+    /** 把未写满的块连同索引交给写线程, 之后的帧从新块开始; 析构时自动调用 */
+    void flush();
+    Status status() const;
+
+private:
+    void finishChunk();
+
+private:
+    size_t chunkBytes_;
+    std::vector<uint8_t> chunk_;
+    size_t used_{ 0 };
+    TmArchiveIndex index_{};
+    uint64_t offset_{ 0 };
+    std::unique_ptr<RecordWriter> data_;
+    std::unique_ptr<RecordWriter> indexFile_;
+
+    std::array<std::atomic<uint64_t>, TM_ARCHIVE_CHANNELS> tsBytes_{};
+    std::atomic<uint64_t> frames_{ 0 };
+    std::atomic<uint64_t> chunks_{ 0 };
+    std::atomic<uint64_t> rejected_{ 0 };
+    std::atomic<bool> channelWarned_{ false };
+};
+
+// 读取: 两个文件都只读映射, 按时间二分查找块, 块内顺序扫描记录头
+class TmArchiveReader
+{
+public:
+    struct Frame
+    {
+        int64_t timeUs;
+        uint16_t sfid;
+        std::span<const uint8_t> data;  // 指向映射区, reader 存在期间有效
+    };
+
+public:
+    TmArchiveReader();
+    ~TmArchiveReader();
+    TmArchiveReader(const TmArchiveReader &) = delete;
+    TmArchiveReader &operator=(const TmArchiveReader &) = delete;
+
+public:
+    /** path 不带扩展名 */
+    bool open(const std::string &path);
+    void close();
+
+    std::span<const TmArchiveIndex> index() const
+    {
+        return index_;
+    }
+    int64_t beginUs() const
+    {
+        return index_.empty() ? 0 : index_.front().firstUs;
+    }
+    int64_t endUs() const
+    {
+        return index_.empty() ? 0 : index_.back().lastUs;
+    }
+
+    /** 第一个可能包含 timeUs 之后帧的块, 没有时返回 index().size() */
+    size_t seek(int64_t timeUs) const;
+
+    /** 按时间顺序把 [beginUs, endUs) 内的帧交给 f(const Frame &), 返回帧数 */
+    template <class F>
+    size_t read(int64_t beginUs, int64_t endUs, F &&f) const
+    {
+        size_t count = 0;
+        for (auto i = seek(beginUs); i < index_.size() && index_[i].firstUs < endUs; ++i)
+        {
+            auto &chunk = index_[i];
+            auto ptr = data_.data() + chunk.offset;
+            for (size_t pos = 0; pos + sizeof(TmArchiveRecord) <= chunk.bytes;)
+            {
+                TmArchiveRecord rec;
+                memcpy(&rec, ptr + pos, sizeof(rec));
+                if (rec.len == 0 || pos + sizeof(rec) + rec.len > chunk.bytes) break;
+                if (rec.timeUs >= endUs) return count;
+                if (rec.timeUs >= beginUs)
+                {
+                    f(Frame{ rec.timeUs, rec.sfid, { ptr + pos + sizeof(rec), rec.len } });
+                    count++;
+                }
+                pos += sizeof(rec) + (rec.len + 7) / 8 * 8;
+            }
+        }
+        return count;
+    }
+
+    /** timeUs 所在块开始时通道 ts 文件的偏移, 从这里开始解码可以覆盖该时刻 */
+    uint64_t tsOffset(int channel, int64_t timeUs) const;
+
+private:
+    struct Mapping;
+    std::unique_ptr<Mapping> dataMap_;
+    std::unique_ptr<Mapping> indexMap_;
+    std::span<const uint8_t> data_;
+    std::span<const TmArchiveIndex> index_;
+};
@@ -1,7 +1,14 @@
 #pragma once
 
+#include "../sti/shm_ring.h"
+#include "../sti/sti_framer.h"
+#include <atomic>
 #include <boost/asio.hpp>
+#include <boost/endian/conversion.hpp>
 #include <chrono>
+#include <cstring>
+#include <functional>
+#include <span>
 #include <spdlog/spdlog.h>
 #include <thread>
 #include <vector>
@@ -9,53 +16,166 @@
 class sti_reader
 {
 public:
+    struct stats
+    {
+        uint64_t messages;     // messages delivered
+        uint64_t bytes;        // message bytes delivered
+        uint64_t copied;       // bytes moved inside the buffer while resyncing, 0 on a clean stream
+        uint64_t resyncs;      // framing errors recovered by searching for the next sync word
+        double msgs_per_sec;   // over the last second
+        uint64_t lost;         // shm only: messages the sender overwrote before they were read
+    };
+
+
+public:
+    /**
+     * ip is either an address of a tm_server, or "shm:<name>" for the shared memory ring a tm_server on this host
+     * writes with add_shm_target(channel, name); then port, channel and flow are not used
+     */
     sti_reader(boost::asio::io_context &io, std::string_view ip, uint16_t port)
         : io_(io)
         , client_(io)
-        , remote_({ boost::asio::ip::address::from_string(ip.data()), port })
     {
+        if (ip.starts_with("shm:"))
+            shm_name_ = ip.substr(4);
+        else
+            remote_ = { boost::asio::ip::address::from_string(std::string(ip)), port };
     }
 
 public:
-    void run(int channel, int flow, std::function<bool(std::string_view msg)> on_read)
+    /**
+     * read whole messages (header .. tail) and hand them to on_read
+     * the span points into the reader's buffer and is only valid during the call
+     * an empty span reports a connection error, return false to stop
+     */
+    void run(int channel, int flow, std::function<bool(std::span<const uint8_t> msg)> on_read)
     {
         bool next = true;
         while (next)
         {
             try
             {
+                if (!shm_name_.empty())
+                {
+                    next = run_shm(on_read);
+                    continue;
+                }
+                boost::system::error_code ignored;
+                client_.close(ignored);
+                // bytes left from the previous connection belong to a stream that is gone
+                have_ = used_ = 0;
                 client_.connect(remote_);
                 client_.send(boost::asio::buffer(make_tm_request(channel, flow)));
-                static std::string TAIL{ (char)0xb6, (char)0x69, (char)0xfd, (char)0x2e };
-                boost::asio::streambuf buffer{ 10240 };
 
+                auto sample_time = std::chrono::steady_clock::now();
+                auto sample_count = messages_.load();
                 while (next)
                 {
-                    boost::system::error_code ec;
-                    auto n = boost::asio::read_until(client_, buffer, TAIL, ec);
-                    // assert(n > 0);
-                    if (ec)
+                    auto len = read_message();
+                    messages_++;
+                    bytes_ += len;
+                    next = on_read({ buffer_.data(), len });
+
+                    auto now = std::chrono::steady_clock::now();
+                    if (now - sample_time >= std::chrono::seconds(1))
                     {
-                        next = on_read("");
-                        buffer.consume(buffer.max_size());
-                        continue;
+                        msgs_per_sec_ = (messages_ - sample_count) / std::chrono::duration<double>(now - sample_time).count();
+                        sample_count = messages_;
+                        sample_time = now;
                     }
-                    std::string line((char *)buffer.data().data(), n);
-                    buffer.consume(n);
-                    next = on_read(line);
                 }
             }
             catch (const std::exception &e)
             {
                 printf("[sti_reader] %s\n", e.what());
-                next = on_read("");
+                next = on_read({});
                 if (next) std::this_thread::sleep_for(std::chrono::seconds(1));
                 continue;
             }
         }
     }
 
+    /** safe to call from any thread while run is going on */
+    stats status() const
+    {
+        return { messages_, bytes_, copied_, resyncs_, msgs_per_sec_, lost_ };
+    }
+
 private:
+    // follow the shared memory ring until on_read says stop (false) or the ring goes away (throws, run reattaches)
+    bool run_shm(const std::function<bool(std::span<const uint8_t> msg)> &on_read)
+    {
+        if (!shm_.open(shm_name_)) throw std::runtime_error("no shm ring " + shm_name_);
+        auto sample_time = std::chrono::steady_clock::now();
+        auto sample_count = messages_.load();
+        while (true)
+        {
+            // a timeout comes back empty every 100 ms so a quiet sender does not pin the caller
+            auto msg = shm_.read(std::chrono::milliseconds(100));
+            lost_ = shm_.get_status().lost;
+            if (!shm_.is_open()) throw std::runtime_error("shm ring " + shm_name_ + " closed");
+            if (!msg.empty())
+            {
+                messages_++;
+                bytes_ += msg.size();
+                if (!on_read(msg)) return false;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - sample_time >= std::chrono::seconds(1))
+            {
+                msgs_per_sec_ = (messages_ - sample_count) / std::chrono::duration<double>(now - sample_time).count();
+                sample_count = messages_;
+                sample_time = now;
+            }
+        }
+    }
+
+    // read one message into buffer_[0, len), resyncing on bad framing
+    size_t read_message()
+    {
+        // a resync may have read past the previous message, keep those bytes
+        if (have_ > used_)
+        {
+            memmove(buffer_.data(), buffer_.data() + used_, have_ - used_);
+            copied_ += have_ - used_;
+        }
+        have_ -= std::min(have_, used_);
+        used_ = 0;
+        while (true)
+        {
+            fill(cortex::STI_HEADER_BYTES);
+            auto len = (size_t)boost::endian::load_big_u32(buffer_.data() + 4);
+            if (boost::endian::load_big_u32(buffer_.data()) == cortex::STI_HEAD && cortex::is_sti_length(len))
+            {
+                fill(len);
+                if (boost::endian::load_big_u32(buffer_.data() + len - 4) == cortex::STI_TAIL) return used_ = len;
+            }
+            resync();
+        }
+    }
+
+    // make sure buffer_ holds at least n bytes, reading exactly what is missing
+    void fill(size_t n)
+    {
+        if (have_ >= n) return;
+        if (buffer_.size() < n) buffer_.resize(n);
+        boost::asio::read(client_, boost::asio::buffer(buffer_.data() + have_, n - have_));
+        have_ = n;
+    }
+
+    // drop bytes up to the next sync word after offset 0, keep a possible partial one at the end
+    void resync()
+    {
+        resyncs_++;
+        auto ptr = buffer_.data();
+        auto pos = 1 + cortex::find_sti_head(ptr + 1, have_ - 1);
+        if (pos == have_) pos = have_ > 3 ? have_ - 3 : have_;
+        memmove(ptr, ptr + pos, have_ - pos);
+        copied_ += have_ - pos;
+        have_ -= pos;
+    }
+
     static std::string make_tm_request(int channel, int flow)
     {
         std::vector<int> ints{ 1234567890, 64, 0, channel, 0, flow, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1234567890 };
@@ -67,4 +187,16 @@ private:
     boost::asio::io_context &io_;
     boost::asio::ip::tcp::socket client_;
     boost::asio::ip::tcp::endpoint remote_;
+    std::string shm_name_;
+    cortex::shm_ring_reader shm_;
+    std::vector<uint8_t> buffer_;  // reused for every message, only grows
+    size_t have_{ 0 };  // valid bytes in buffer_
+    size_t used_{ 0 };  // length of the message last handed out
+
+    std::atomic<uint64_t> messages_{ 0 };
+    std::atomic<uint64_t> bytes_{ 0 };
+    std::atomic<uint64_t> copied_{ 0 };
+    std::atomic<uint64_t> resyncs_{ 0 };
+    std::atomic<uint64_t> lost_{ 0 };  // copy of shm_'s count, status does not touch shm_ while run opens and closes it
+    std::atomic<double> msgs_per_sec_{ 0 };
 };
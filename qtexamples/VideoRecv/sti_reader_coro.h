@@ -1,94 +1,238 @@
 #pragma once
 
+#include "../sti/sti_framer.h"
+#include <atomic>
 #include <boost/asio.hpp>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
 #include <vector>
 
-using boost::asio::awaitable;
-using boost::asio::co_spawn;
-using boost::asio::detached;
-using boost::asio::use_awaitable;
-using boost::asio::ip::tcp;
-namespace this_coro = boost::asio::this_coro;
-
-///  fix it
-using Iterator = boost::asio::buffers_iterator<boost::asio::streambuf::const_buffers_type>;
-static std::pair<Iterator, bool> match_sti_frame(Iterator begin, Iterator end)
+/**
+ * one io_context thread driving many telemetry subscriptions
+ * every subscription is a coroutine with its own socket and read buffer,
+ * it reconnects with exponential backoff until stop() is called
+ * the coroutines hold the sessions and the stop flag themselves, so the reader may go away before io_context finishes
+ */
+class sti_reader_coro
 {
-    static constexpr std::array<uint8_t, 4> HEAD{ 0x49, 0x96, 0x02, 0xd2 };
-    static constexpr std::array<uint8_t, 4> TAIL{ 0xb6, 0x69, 0xfd, 0x2e };
-    auto bytes = std::distance(begin, end);
-    if (bytes < 68)
+public:
+    enum class protocol
     {
-        return { begin, false };
-    }
+        CRT,
+        HDR,
+    };
 
-    Iterator head_pos = end;
-    bool tail = false;
-    for (auto i = begin; i != end; i++)
+    struct subscription
     {
-        auto cursor = boost::asio::detail::socket_ops::host_to_network_long(*(int *)(i.operator->()));
-        if (cursor != 1234567890)
-        {
-            continue;
-        }
-        return { begin, true };
-    }
-    return { begin, false };
-};
+        std::string ip;
+        uint16_t port{ 3070 };
+        protocol type{ protocol::CRT };
+        int channel{ 0 };
+        int flow{ 0 };
+        int block_num{ 0 };  // HDR only
+    };
+
+    struct stats
+    {
+        uint64_t messages;
+        uint64_t bytes;
+        uint64_t resyncs;
+        uint64_t reconnects;
+    };
+
+    /** id of the subscription and one whole message (header .. tail), valid only during the call */
+    using callback = std::function<void(size_t id, std::span<const uint8_t> msg)>;
+
+    constexpr static size_t READ_BUFFER_BYTES = 256 << 10;
+    constexpr static auto MIN_BACKOFF = std::chrono::milliseconds(100);
+    constexpr static auto MAX_BACKOFF = std::chrono::seconds(10);
 
-class sti_reader
-{
 public:
-    sti_reader(boost::asio::io_context &io, std::string_view ip, uint16_t port)
+    sti_reader_coro(boost::asio::io_context &io)
         : io_(io)
-        , client_(io)
-        , remote_({ boost::asio::ip::address::from_string(ip.data()), port })
     {
     }
 
+    ~sti_reader_coro()
+    {
+        stop();
+    }
+
 public:
-    void run(int channel, int flow, std::function<bool(std::string_view msg)> on_read)
+    /** start a subscription, call before io_context runs or from its thread */
+    size_t subscribe(subscription sub, callback on_read)
+    {
+        auto s = std::make_shared<session>(io_, std::move(sub), std::move(on_read));
+        s->id = sessions_.size();
+        sessions_.push_back(s);
+        boost::asio::co_spawn(io_, run_session(stopped_, s), boost::asio::detached);
+        return s->id;
+    }
+
+    /** close every connection, the coroutines finish on the io_context thread */
+    void stop()
+    {
+        if (stopped_->exchange(true)) return;
+        boost::asio::post(io_, [sessions = sessions_] {
+            for (auto &s : sessions)
+            {
+                boost::system::error_code ec;
+                s->socket.close(ec);
+                s->timer.cancel();
+            }
+        });
+    }
+
+    size_t size() const
+    {
+        return sessions_.size();
+    }
+
+    stats status(size_t id) const
+    {
+        auto &s = *sessions_.at(id);
+        return { s.messages, s.bytes, s.resyncs, s.reconnects };
+    }
+
+    stats total() const
     {
-        co_spawn(io_, read_sti_frame(channel, flow, std::move(on_read)), detached);
+        stats t{};
+        for (auto &s : sessions_)
+        {
+            t.messages += s->messages;
+            t.bytes += s->bytes;
+            t.resyncs += s->resyncs;
+            t.reconnects += s->reconnects;
+        }
+        return t;
     }
 
 private:
-    static std::string make_tm_request(int channel, int flow)
+    struct session
+    {
+        session(boost::asio::io_context &io, subscription s, callback cb)
+            : sub(std::move(s))
+            , on_read(std::move(cb))
+            , socket(io)
+            , timer(io)
+            , buffer(READ_BUFFER_BYTES)
+        {
+        }
+
+        size_t id{ 0 };
+        subscription sub;
+        callback on_read;
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::steady_timer timer;
+        std::vector<uint8_t> buffer;
+        size_t begin{ 0 };  // first unparsed byte
+        size_t end{ 0 };    // end of received bytes
+
+        std::atomic<uint64_t> messages{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<uint64_t> resyncs{ 0 };
+        std::atomic<uint64_t> reconnects{ 0 };
+    };
+    using session_ptr = std::shared_ptr<session>;
+
+    static std::vector<int> make_tm_request(const subscription &sub)
     {
-        std::vector<int> ints{ 1234567890, 64, 0, channel, 0, flow, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1234567890 };
+        std::vector<int> ints;
+        if (sub.type == protocol::HDR)
+        {
+            ints.assign(32, 0);
+            ints[0] = 1234567890;
+            ints[1] = 128;
+            ints[3] = sub.channel;
+            ints[4] = sub.flow;
+            ints[8] = sub.block_num;
+            ints[31] = -1234567890;
+        }
+        else
+        {
+            ints = { 1234567890, 64, 0, sub.channel, 0, sub.flow, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1234567890 };
+        }
         std::transform(ints.begin(), ints.end(), ints.begin(), boost::asio::detail::socket_ops::host_to_network_long);
-        return std::string((char *)ints.data(), ints.size() * sizeof(int));
+        return ints;
     }
 
-    awaitable<void> read_sti_frame(int channel, int flow, std::function<bool(std::string_view msg)> on_read)
+    // static, touches nothing of the reader but what it was handed
+    static boost::asio::awaitable<void> run_session(std::shared_ptr<const std::atomic<bool>> stopped, session_ptr s)
     {
-        co_await client_.async_connect(remote_, use_awaitable);
-        co_await client_.async_send(boost::asio::buffer(make_tm_request(channel, flow)), use_awaitable);
-        static std::string TAIL{ (char)0xb6, (char)0x69, (char)0xfd, (char)0x2e };
-        boost::asio::streambuf buffer{ 10240 };
-
-        bool next = true;
-        while (next)
+        using boost::asio::use_awaitable;
+        auto backoff = std::chrono::steady_clock::duration(MIN_BACKOFF);
+        boost::asio::ip::tcp::endpoint remote{ boost::asio::ip::make_address(s->sub.ip), s->sub.port };
+        while (!*stopped)
         {
-            boost::system::error_code ec;
-            size_t n = co_await boost::asio::async_read_until(client_, buffer, TAIL, use_awaitable);
-            assert(n > 0);
-            if (ec)
+            try
+            {
+                s->socket = boost::asio::ip::tcp::socket(s->socket.get_executor());
+                co_await s->socket.async_connect(remote, use_awaitable);
+                s->socket.set_option(boost::asio::ip::tcp::no_delay(true));
+                co_await boost::asio::async_write(s->socket, boost::asio::buffer(make_tm_request(s->sub)), use_awaitable);
+                s->begin = s->end = 0;
+                while (!*stopped)
+                {
+                    make_room(*s);
+                    auto n = co_await s->socket.async_read_some(
+                        boost::asio::buffer(s->buffer.data() + s->end, s->buffer.size() - s->end), use_awaitable);
+                    s->end += n;
+                    if (parse(*s) > 0) backoff = MIN_BACKOFF;
+                }
+            }
+            catch (const std::exception &e)
             {
-                next = on_read("");
-                buffer.consume(buffer.max_size());
-                continue;
+                if (*stopped) break;
+                printf("[sti_reader_coro] %s:%d %s\n", s->sub.ip.c_str(), s->sub.port, e.what());
             }
-            std::string line((char *)buffer.data().data(), n);
-            buffer.consume(n);
-            next = on_read(line);
+
+            s->reconnects++;
+            boost::system::error_code ec;
+            s->socket.close(ec);
+            s->timer.expires_after(backoff);
+            co_await s->timer.async_wait(boost::asio::redirect_error(use_awaitable, ec));
+            backoff = std::min<std::chrono::steady_clock::duration>(backoff * 2, MAX_BACKOFF);
+        }
+    }
+
+    // move the unparsed tail to the front, grow when a single message does not fit
+    static void make_room(session &s)
+    {
+        if (s.begin == s.end)
+        {
+            s.begin = s.end = 0;
         }
+        else if (s.end == s.buffer.size())
+        {
+            memmove(s.buffer.data(), s.buffer.data() + s.begin, s.end - s.begin);
+            s.end -= s.begin;
+            s.begin = 0;
+        }
+        if (s.end == s.buffer.size()) s.buffer.resize(s.buffer.size() * 2);
+    }
 
-        co_return;
+    // hand out every complete message in [begin, end), return how many
+    static size_t parse(session &s)
+    {
+        size_t count = 0;
+        s.begin += cortex::parse_sti_frames(
+            s.buffer.data() + s.begin, s.end - s.begin,
+            [&s, &count](const uint8_t *msg, size_t len) {
+                s.messages++;
+                s.bytes += len;
+                count++;
+                s.on_read(s.id, { msg, len });
+            },
+            s.resyncs);
+        return count;
     }
 
 private:
     boost::asio::io_context &io_;
-    boost::asio::ip::tcp::socket client_;
-    boost::asio::ip::tcp::endpoint remote_;
+    std::vector<session_ptr> sessions_;
+    std::shared_ptr<std::atomic<bool>> stopped_{ std::make_shared<std::atomic<bool>>(false) };  // shared with every run_session
 };
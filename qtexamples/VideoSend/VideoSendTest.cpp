@@ -3,6 +3,7 @@
 #include "cfte_video_fmt1.hpp"
 #include "ff_capture.h"
 #include "ff_encoder.h"
+#include "sti/rate_pacer.h"
 #include <QApplication>
 #include <QComboBox>
 #include <QDataStream>
@@ -57,6 +58,7 @@ VideoSendTest::VideoSendTest(QWidget *parent)
     ui_.Format->setCurrentIndex(form_.format);
     ui_.Port->setValue(form_.port);
     ui_.RtrChannel->setValue(form_.rtrchannel);
+    ui_.ShmTarget->setChecked(form_.shmTarget);
     ui_.SyncBytes->setCurrentText(QString::number(form_.synclen));
     ui_.SyncValue->setText(QString::number(form_.syncword, 16).toUpper());
     ui_.FrameBytes->setValue(form_.framelen);
@@ -86,6 +88,7 @@ void VideoSendTest::ctrlSend(bool checked)
         form_.format = ui_.Format->currentIndex();
         form_.port = ui_.Port->value();
         form_.rtrchannel = ui_.RtrChannel->value();
+        form_.shmTarget = ui_.ShmTarget->isChecked();
         form_.synclen = ui_.SyncBytes->currentText().toUInt();
         form_.syncword = ui_.SyncValue->text().toULongLong(nullptr, 16);
         form_.framelen = ui_.FrameBytes->value();
@@ -122,6 +125,11 @@ void VideoSendTest::doStart()
         32,
         (int)form_.framelen,
     });
+    //勾选共享内存时, 同一主机的接收端可以用 "shm:VideoSend.<端口>" 代替地址, 从共享内存读取, 没有接收端时不产生拷贝
+    if (form_.shmTarget)
+    {
+        tmserver_->add_shm_target(form_.rtrchannel, "VideoSend." + std::to_string(ui_.Port->value()));
+    }
     tmserver_->bind(ui_.Port->value());
     tmserver_->start();
 
@@ -146,18 +154,19 @@ void VideoSendTest::doStart()
     }
 
     outThread_ = std::thread([this] {
-        // io_.run();
-        auto t0 = QDateTime::currentMSecsSinceEpoch();
-        auto last = t0;
-        while (!interrupted_)
+        // 按绝对时刻输出副帧, 睡到节拍前再短暂自旋, 不再忙等毫秒时钟
+        rate_pacer pacer(1000.0 / OUTPUT_INTERVAL);
+        const auto reportFrames = 10 * 1000 / OUTPUT_INTERVAL;
+        for (size_t n = 1; !interrupted_; ++n)
         {
-            auto now = QDateTime::currentMSecsSinceEpoch();
-            if (now - last < OUTPUT_INTERVAL)
+            pacer.wait();
+            outputPictures();
+            if (n % reportFrames == 0)
             {
-                continue;
+                auto st = pacer.get_stats();
+                printf("[VideoSendTest] %.2f frames/s, jitter p50 %.1f us p99 %.1f us max %.1f us, %llu resyncs\n", st.rate, st.jitter_p50_us,
+                    st.jitter_p99_us, st.jitter_max_us, (unsigned long long)st.resyncs);
             }
-            last = now;
-            outputPictures();
         }
     });
 
@@ -211,7 +220,7 @@ void VideoSendTest::outputPictures()
     {
         auto now = QDateTime::currentMSecsSinceEpoch();
         auto frame = fmt1_->make_sub_frame();
-        tmserver_->push(form_.rtrchannel, now, std::make_shared<std::vector<uint8_t>>(frame));
+        tmserver_->push(form_.rtrchannel, now, frame.data(), frame.size());
     }
 }
 
@@ -222,7 +231,8 @@ void VideoSendTest::saveCurrentConfig()
     {
         QDataStream out(&file);
         out << form_.channel << form_.format << form_.port << form_.syncword << form_.synclen << form_.framelen << form_.sfidlen << form_.sfidmin
-            << form_.sfidmax << form_.reservedlen << form_.bigendian << form_.rtrchannel << form_.forwardIp << form_.forwardPort;
+            << form_.sfidmax << form_.reservedlen << form_.bigendian << form_.rtrchannel << form_.forwardIp << form_.forwardPort
+            << form_.shmTarget;
         file.close();
     }
 }
@@ -236,6 +246,10 @@ void VideoSendTest::loadLastConfig()
 
         in >> form_.channel >> form_.format >> form_.port >> form_.syncword >> form_.synclen >> form_.framelen >> form_.sfidlen >> form_.sfidmin >>
             form_.sfidmax >> form_.reservedlen >> form_.bigendian >> form_.rtrchannel >> form_.forwardIp >> form_.forwardPort;
+        if (!in.atEnd())
+        {
+            in >> form_.shmTarget;
+        }
 
         file.close();
     }
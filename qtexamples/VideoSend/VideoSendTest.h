@@ -65,6 +65,7 @@ private:
         int format{ 0 };
         int port{ 3070 };
         int rtrchannel{ 0 };
+        bool shmTarget{ false };
         size_t syncword{ 0xFE6B2840 };
         size_t synclen{ 4 };
         int framelen{ 512 };
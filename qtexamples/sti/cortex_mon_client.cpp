@@ -15,7 +15,7 @@ cortex::cortex_mon_client::cortex_mon_client(const std::string &ip)
     mon_request_ += 1234567890, 20, 0, 0, -1234567890;
     std::transform(mon_request_.begin(), mon_request_.end(), mon_request_.begin(), std::function<int(int)>(htonl));
 
-    sti_parser_->set_tm_msg_callback_fun([&](const cortex::data_ptr tm_msg) {
+    sti_parser_->set_tm_msg_callback_fun([&](const cortex::tm_msg_ptr &tm_msg) {
         if (tm_msg->size() == 20)
         {
             auto ptr = (int *)recv_buf_.data();
@@ -1,10 +1,8 @@
 ﻿#include "cortex_sti_parser.h"
 #include "lockfree_spsc_queue.h"
+#include "sti_framer.h"
 #include <iostream>
 
-const static int32_t CORTEX_MSG_HEADER = 1234567890;   // Cortex 数据包头
-const static int32_t CORTEX_MSG_TAILER = -1234567890;  // Cortex 数据包尾
-
 namespace cortex
 {
     struct cortex_sti_parser::cortex_sti_parser_imp_t
@@ -14,12 +12,28 @@ namespace cortex
         {
         }
 
+        void emit(const uint8_t *msg, size_t len)
+        {
+            msg_count_++;
+            if (tm_msg_view_callback_fun_)
+            {
+                tm_msg_view_callback_fun_(msg, len);
+            }
+            if (tm_msg_callback_fun_)
+            {
+                tm_msg_callback_fun_(tm_buffer_pool::instance().copy(msg, len));
+            }
+        }
+
         std::atomic_bool is_running_ = false;
         std::atomic_uint64_t lost_count_ = 0;
-        lockfree_spsc_queue<uint8_t> data_buf_;
-        std::vector<uint8_t> parse_buf_;
+        std::atomic_uint64_t msg_count_ = 0;
+        std::atomic_uint64_t error_count_ = 0;
+        lockfree_spsc_queue<uint8_t, spsc_wait::spin_park<>> data_buf_;  // 数据成批到达, 先自旋一会再睡眠, 接收线程只在解析线程睡着时才唤醒
+        sti_stream_framer framer_;  // 只在解析线程使用
         std::thread parse_thread_;
         tm_msg_callback_fun_t tm_msg_callback_fun_ = nullptr;
+        tm_msg_view_callback_fun_t tm_msg_view_callback_fun_ = nullptr;
     };
 
     cortex_sti_parser::cortex_sti_parser(size_t capacity)
@@ -45,83 +59,19 @@ namespace cortex
             imp_->lost_count_ = 0;
 
             imp_->parse_thread_ = std::thread([=]() {
-                //初始化Cortex消息头和尾
-                std::vector<uint8_t> msg_head(sizeof(int32_t));
-                memcpy(msg_head.data(), &CORTEX_MSG_HEADER, sizeof(CORTEX_MSG_HEADER));
-                std::reverse(msg_head.begin(), msg_head.end());
-
-                std::vector<uint8_t> msg_tail(sizeof(int32_t));
-                memcpy(msg_tail.data(), &CORTEX_MSG_TAILER, sizeof(CORTEX_MSG_TAILER));
-                std::reverse(msg_tail.begin(), msg_tail.end());
-
+                // 直接在接收环形缓存里解析, 消息以指针+长度交出; 只有跨过环形缓存尾部的那一包才拷贝出来拼接
+                auto &ring = imp_->data_buf_;
+                auto &framer = imp_->framer_;
+                auto emit = [this](const uint8_t *msg, size_t len) {
+                    imp_->emit(msg, len);
+                };
+                framer.reset();
                 try
                 {
-                    std::vector<uint8_t> vec_4bytes(4, 0x0);
                     while (imp_->is_running_)
                     {
-                        auto poped_data = imp_->data_buf_.pop();
-                        //弹出缓存所有数据到解析器缓存
-                        auto existed_size = imp_->parse_buf_.size();
-                        imp_->parse_buf_.resize(existed_size + poped_data->size());
-                        std::copy(poped_data->begin(), poped_data->end(), imp_->parse_buf_.begin() + existed_size);
-
-                        //搜索Cortex消息头
-                        auto head = std::search(imp_->parse_buf_.begin(), imp_->parse_buf_.end(), msg_head.begin(), msg_head.end());
-                        auto index = 0, len = 0, tail = 0;
-                        while (head != imp_->parse_buf_.end())
-                        {
-                            index = head - imp_->parse_buf_.begin();
-                            if (index + sizeof(int32_t) * 2 < imp_->parse_buf_.size())
-                            {
-                                //根据STI获取数据长度
-                                std::copy(head + sizeof(int32_t), head + sizeof(int32_t) * 2, vec_4bytes.begin());
-                                std::reverse(vec_4bytes.begin(), vec_4bytes.end());
-                                memcpy(&len, vec_4bytes.data(), sizeof(int32_t));
-                                //判断缓存内是否包含完整该包数据
-                                if (index + len <= imp_->parse_buf_.size())
-                                {
-                                    //根据STI获取TCP-tail
-                                    std::copy(head + len - sizeof(int32_t), head + len, vec_4bytes.begin());
-                                    std::reverse(vec_4bytes.begin(), vec_4bytes.end());
-                                    memcpy(&tail, vec_4bytes.data(), sizeof(int32_t));
-                                    if (tail == CORTEX_MSG_TAILER)
-                                    {
-                                        data_ptr tm_msg(new std::vector<uint8_t>(head, head + len));
-                                        if (imp_->tm_msg_callback_fun_)
-                                        {
-                                            imp_->tm_msg_callback_fun_(tm_msg);
-                                        }
-                                        head = std::search(head + len, imp_->parse_buf_.end(), msg_head.begin(), msg_head.end());
-                                    }
-                                    else
-                                    {
-                                        // TODO:log frame error
-                                        std::cerr << "[cortex_sti_parser]: "
-                                                  << "telemetry message format error." << std::endl;
-                                        //帧格式错误在当前帧头后继续寻找帧头
-                                        head = std::search(head + sizeof(CORTEX_MSG_HEADER), imp_->parse_buf_.end(), msg_head.begin(), msg_head.end());
-                                    }
-                                }
-                                else
-                                {
-                                    break;
-                                }
-                            }
-                            else
-                            {
-                                break;
-                            }
-                        }
-
-                        if (head != imp_->parse_buf_.end())
-                        {
-                            imp_->parse_buf_.erase(imp_->parse_buf_.begin(), head);
-                        }
-                        else if (imp_->parse_buf_.size() > 3)
-                        {
-                            //预留3个字节防止包头跨包
-                            imp_->parse_buf_.erase(imp_->parse_buf_.begin(), head - 3);
-                        }
+                        ring.read_span(framer.need());
+                        framer.step(ring, emit, imp_->error_count_);
                     }
                 }
                 catch (std::exception e)
@@ -143,7 +93,6 @@ namespace cortex
                 imp_->parse_thread_.join();
 
                 imp_->data_buf_.reset();
-                imp_->parse_buf_.clear();
             }
         }
     }
@@ -153,13 +102,35 @@ namespace cortex
         imp_->lost_count_ += (end - imp_->data_buf_.push(begin, end));
     }
 
+    int cortex_sti_parser::receive(const std::function<int(uint8_t *data, size_t len)> &read)
+    {
+        auto &ring = imp_->data_buf_;
+        auto span = imp_->is_running_ ? ring.write_span_wait() : ring.write_span();
+        if (span.empty())
+        {
+            //没有解析线程腾出空间, 读出来丢弃, 与 push_data 缓存满时一样计入 lost
+            uint8_t discard[64 * 1024];
+            auto bytes = read(discard, sizeof(discard));
+            if (bytes > 0) imp_->lost_count_ += bytes;
+            return bytes;
+        }
+        auto bytes = read(span.data(), span.size());
+        if (bytes > 0) ring.commit(bytes);
+        return bytes;
+    }
+
     void cortex_sti_parser::set_tm_msg_callback_fun(const tm_msg_callback_fun_t &fun)
     {
         imp_->tm_msg_callback_fun_ = fun;
     }
 
+    void cortex_sti_parser::set_tm_msg_view_callback_fun(const tm_msg_view_callback_fun_t &fun)
+    {
+        imp_->tm_msg_view_callback_fun_ = fun;
+    }
+
     cortex_sti_parser::buffer_status cortex_sti_parser::get_buffer_status() const
     {
-        return buffer_status{ imp_->data_buf_.capacity(), imp_->data_buf_.used_size(), imp_->lost_count_ };
+        return buffer_status{ imp_->data_buf_.capacity(), imp_->data_buf_.used_size(), imp_->lost_count_, imp_->msg_count_, imp_->error_count_ };
     }
 }  // namespace cortex
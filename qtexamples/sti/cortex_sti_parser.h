@@ -7,6 +7,7 @@
 #pragma warning(disable : 4251)
 #pragma warning(disable : 4996)
 
+#include "tm_buffer_pool.h"
 #include <functional>
 #include <memory>
 #include <vector>
@@ -19,7 +20,10 @@ namespace cortex
      ***************************************************************/
     typedef std::vector<uint8_t>::iterator iterator_type;
     typedef std::shared_ptr<std::vector<uint8_t>> data_ptr;
-    typedef std::function<void(const data_ptr)> tm_msg_callback_fun_t;
+    // Ϣ tm_buffer_pool ĳػ, Կ̳߳
+    typedef std::function<void(const tm_msg_ptr &)> tm_msg_callback_fun_t;
+    // Ϣֱָ, ֻڻصڼЧ
+    typedef std::function<void(const uint8_t *msg, size_t len)> tm_msg_view_callback_fun_t;
 
     class cortex_sti_parser
     {
@@ -31,13 +35,23 @@ namespace cortex
         void start();
         void stop();
         void push_data(iterator_type begin, iterator_type end);
+        /**
+         * ֱ߳ӶĿж, м仺 push_data Ŀ
+         * @param read read(ptr, len)  len ֽڵ ptr, ضֽ, <= 0 ʾ
+         * @return read ķֵ
+         * @note ʱ͵ȴڳռ( TCP öԶ˽), ; δʱݼ lost
+         */
+        int receive(const std::function<int(uint8_t *data, size_t len)> &read);
         void set_tm_msg_callback_fun(const tm_msg_callback_fun_t &fun);
+        void set_tm_msg_view_callback_fun(const tm_msg_view_callback_fun_t &fun);
 
         struct buffer_status
         {
             size_t capacity;
             size_t used;
             size_t lost;
+            size_t messages;  // ѽϢ
+            size_t errors;    // ֡ʽ
         };
         buffer_status get_buffer_status() const;
 
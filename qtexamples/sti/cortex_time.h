@@ -5,60 +5,66 @@
     #define _WIN32_WINNT 0x0501
 #endif
 #include <boost/asio.hpp>
+#include <boost/endian/conversion.hpp>
+#include <bit>
 
 namespace cortex
 {
-    // return ms
-    const static double parse_crtx_time(int time_code, const unsigned char *data, int index)
+    /**
+     * decode count time tags at data + index, data + index + stride, ... and hand each to out(i, ms)
+     * the time code is dispatched once and the loop body is branch-free
+     * so the compiler can unroll / vectorise it across blocks
+     */
+    template <class Out>
+    static void parse_crtx_times(int time_code, const unsigned char *data, size_t index, size_t stride, size_t count, Out &&out)
     {
-        double time = 0.0;
-        unsigned int sec, msec, mic;
-        memcpy(&sec, data + index, sizeof(int));
-        memcpy(&msec, data + index + sizeof(int), sizeof(int));
-        memcpy(&mic, data + index + sizeof(int), sizeof(int));
-        sec = ntohl(sec);
-        msec = ntohl(msec);
-        mic = ntohl(mic);
-
-        if (time_code == 0)
+        using boost::endian::load_big_u32;
+        auto p = data + index;
+        switch (time_code)
         {
-            time = (double)sec * 1000 + msec;
-        }
-        else if (time_code == 1)
-        {
-            int day = (sec >> 8) & 0xFFFF;
-            int hour = sec & 0xFF;
-            int minute = ((int)msec >> 24) & 0xFF;
-            int second = ((int)msec >> 16) & 0xFF;
-            int millisecond = ((int)msec) & 0xFFFF;
-            time = (day * 24 * 60 * 60 + hour * 60 * 60 + minute * 60 + second) * 1000.0 + millisecond;
-        }
-        else if (time_code == 2)
-        {
-            typedef union
+        case 0:
+            for (size_t i = 0; i < count; ++i, p += stride)
             {
-                struct
-                {
-                    unsigned char byte1;
-                    unsigned char byte2;
-                    unsigned char byte3;
-                    unsigned char byte4;
-                } float_byte;
-
-                float value;
-            } FLOAT_UNION;
-
-            FLOAT_UNION float_union;
-            float_union.float_byte.byte1 = data[index + sizeof(int) + 3];
-            float_union.float_byte.byte2 = data[index + sizeof(int) + 2];
-            float_union.float_byte.byte3 = data[index + sizeof(int) + 1];
-            float_union.float_byte.byte4 = data[index + sizeof(int)];
-            time = (double)sec * 1000 + float_union.value;
-        }
-        else if (time_code == 3)
-        {
-            time = (double)sec * 1000 + (double)mic / 1e3;
+                out(i, (double)load_big_u32(p) * 1000 + load_big_u32(p + 4));
+            }
+            break;
+        case 1:
+            for (size_t i = 0; i < count; ++i, p += stride)
+            {
+                auto sec = load_big_u32(p);
+                auto msec = load_big_u32(p + 4);
+                auto seconds = ((sec >> 8) & 0xFFFF) * 86400ull + (sec & 0xFF) * 3600 + ((msec >> 24) & 0xFF) * 60 + ((msec >> 16) & 0xFF);
+                out(i, seconds * 1000.0 + (msec & 0xFFFF));
+            }
+            break;
+        case 2:
+            for (size_t i = 0; i < count; ++i, p += stride)
+            {
+                out(i, (double)load_big_u32(p) * 1000 + std::bit_cast<float>(load_big_u32(p + 4)));
+            }
+            break;
+        case 3:
+            for (size_t i = 0; i < count; ++i, p += stride)
+            {
+                out(i, (double)load_big_u32(p) * 1000 + load_big_u32(p + 4) / 1e3);
+            }
+            break;
+        default:
+            for (size_t i = 0; i < count; ++i)
+            {
+                out(i, 0.0);
+            }
+            break;
         }
+    }
+
+    // return ms, a single time tag decoded by parse_crtx_times (day-of-year codes need the 64-bit seconds)
+    static double parse_crtx_time(int time_code, const unsigned char *data, int index)
+    {
+        double time = 0.0;
+        parse_crtx_times(time_code, data, index, 0, 1, [&time](size_t, double ms) {
+            time = ms;
+        });
         return time;
     }
 }  // namespace cortex
\ No newline at end of file
@@ -12,7 +12,6 @@ using namespace boost::assign;
 namespace cortex
 {
     cortex_tm_client::cortex_tm_client()
-        : recv_buf_(BUFFER_MAX_SIZE)
     {
     }
 
@@ -37,7 +36,13 @@ namespace cortex
         if (!is_running_)
         {
             is_running_ = true;
+            //ֱӶʱҪм仺
+            if (!tm_parser_ && recv_buf_.empty())
+                recv_buf_.resize(BUFFER_MAX_SIZE);
             thread_ = std::thread([=]() {
+                auto receive = [this](uint8_t *data, size_t len) {
+                    return sync_tcp_client::receive_some(data, len);
+                };
                 while (is_running_)
                 {
                     if (connect(tm_config_.ip, tm_config_.port))
@@ -52,10 +57,12 @@ namespace cortex
                             {
                                 try
                                 {
-                                    size_t receive_bytes = sync_tcp_client::receive_some(recv_buf_);  //ʵԶӦȥ
+                                    //ʵԶӦȥ
+                                    // պ int, ʱΪ, ֱӵ
+                                    int receive_bytes = tm_parser_ ? tm_parser_->receive(receive) : sync_tcp_client::receive_some(recv_buf_);
                                     if (receive_bytes > 0)
                                     {
-                                        if (tm_data_callback_fun_)
+                                        if (!tm_parser_ && tm_data_callback_fun_)
                                             tm_data_callback_fun_(recv_buf_.begin(), recv_buf_.begin() + receive_bytes);
                                     }
                                     else
@@ -110,6 +117,11 @@ namespace cortex
         tm_data_callback_fun_ = fun;
     }
 
+    void cortex_tm_client::set_tm_parser(const cortex_sti_parser_ptr &parser)
+    {
+        tm_parser_ = parser;
+    }
+
     void cortex_tm_client::set_error_log_callback_fun(const error_log_callback_fun_t &fun)
     {
         error_log_callback_fun_ = fun;
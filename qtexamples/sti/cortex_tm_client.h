@@ -6,6 +6,7 @@
 #pragma warning(disable : 4275)
 #pragma warning(disable : 4834)
 
+#include "cortex_sti_parser.h"
 #include "tcp_client.h"
 #include <atomic>
 #include <functional>
@@ -51,6 +52,8 @@ namespace cortex
         void start();
         void stop();
         void set_tm_data_callback_fun(const tm_data_callback_fun_t &fun);
+        /** read straight into the parser's ring instead of recv_buf_, the data callback is not called then; set before start() */
+        void set_tm_parser(const cortex_sti_parser_ptr &parser);
         void set_error_log_callback_fun(const error_log_callback_fun_t &fun);
 
     protected:
@@ -59,7 +62,8 @@ namespace cortex
     protected:
         cortex_tm_config tm_config_;
         std::atomic_bool is_running_ = false;
-        std::vector<uint8_t> recv_buf_;
+        std::vector<uint8_t> recv_buf_;  // only allocated when there is no tm_parser_
+        cortex_sti_parser_ptr tm_parser_ = nullptr;
         std::thread thread_;
         tm_data_callback_fun_t tm_data_callback_fun_ = nullptr;
         error_log_callback_fun_t error_log_callback_fun_ = nullptr;
@@ -1,6 +1,9 @@
 #include "cortex_tm_parser.h"
 #include "cortex_time.h"
 #include "lockfree_spsc_queue.h"
+#include <boost/endian/conversion.hpp>
+
+const static size_t PARSE_BATCH_SIZE = 256;  // ߳һȡϢ
 
 namespace cortex
 {
@@ -13,7 +16,7 @@ namespace cortex
 
         std::atomic_bool is_running_ = false;
         std::atomic_uint64_t lost_count_ = 0;
-        lockfree_spsc_queue<data_ptr> data_buf_;
+        lockfree_spsc_queue<tm_msg_ptr> data_buf_;
         std::thread process_thread_;
     };
 
@@ -40,12 +43,15 @@ namespace cortex
             imp_->lost_count_ = 0;
             //ռ
             imp_->process_thread_ = std::thread([=]() {
+                // ȡϢڸõ, ͷ, ûص
+                std::vector<tm_msg_ptr> tm_msgs(PARSE_BATCH_SIZE);
                 while (imp_->is_running_)
                 {
-                    auto tm_msgs = imp_->data_buf_.pop();
-                    for (auto ptm_msg : *tm_msgs)
+                    auto count = imp_->data_buf_.pop(tm_msgs.data(), tm_msgs.size());
+                    for (size_t i = 0; i < count; ++i)
                     {
-                        parse_tm_msg(ptm_msg);
+                        parse_tm_msg(tm_msgs[i]);
+                        tm_msgs[i].reset();
                     }
                 }
             });
@@ -66,7 +72,7 @@ namespace cortex
         }
     }
 
-    void cortex_tm_parser::push_tm_msg(const data_ptr ptm_msg)
+    void cortex_tm_parser::push_tm_msg(const tm_msg_ptr &ptm_msg)
     {
         if (!imp_->data_buf_.push(ptm_msg))
         {
@@ -79,6 +85,29 @@ namespace cortex
         tm_frame_callback_fun_ = fun;
     }
 
+    void cortex_tm_parser::set_tm_frames_callback_fun(const tm_frames_callback_fun_t &fun)
+    {
+        tm_frames_callback_fun_ = fun;
+    }
+
+    void cortex_tm_parser::emit_frames(const tm_msg_ptr &ptm_msg)
+    {
+        if (tm_frames_callback_fun_)
+        {
+            tm_frames_callback_fun_(ptm_msg, frames_);
+        }
+        if (tm_frame_callback_fun_)
+        {
+            tm_frame frame{ ptm_msg, 0, 0 };
+            for (auto &desc : frames_)
+            {
+                frame.frame_offset = desc.offset;
+                frame.frame_len = desc.len;
+                tm_frame_callback_fun_(desc.time, frame);
+            }
+        }
+    }
+
     cortex_tm_parser::buffer_status cortex_tm_parser::get_buffer_status() const
     {
         return buffer_status{ imp_->data_buf_.capacity(), imp_->data_buf_.used_size(), imp_->lost_count_ };
@@ -102,46 +131,51 @@ namespace cortex
     {
     }
 
-    void hdr_tm_parser::parse_tm_msg(const data_ptr ptm_msg)
+    size_t hdr_tm_parser::extract_frames(const uint8_t *ptr, size_t len, int time_code, std::vector<tm_frame_desc> &frames)
     {
-        if (ptm_msg->size() > (HDR_FIRST_TM_BLOCK_OFFSET + 1) * sizeof(int32_t))
+        using boost::endian::load_big_u32;
+        frames.clear();
+        if (len > (HDR_FIRST_TM_BLOCK_OFFSET + 1) * sizeof(int32_t))
         {
-            std::vector<uint8_t> vec_4bytes(sizeof(int32_t), 0x0);
             uint32_t first_tm_block_pos = HDR_FIRST_TM_BLOCK_OFFSET * sizeof(int32_t);
 
-            uint32_t frame_len, tm_block_size, tm_block_num;
-            memcpy(vec_4bytes.data(), ptm_msg->data() + HDR_FRAME_LENGTH_OFFSET * sizeof(int32_t), sizeof(int32_t));
-            std::reverse(vec_4bytes.begin(), vec_4bytes.end());
-            memcpy(&frame_len, vec_4bytes.data(), sizeof(int32_t));
-
-            memcpy(vec_4bytes.data(), ptm_msg->data() + HDR_TM_BLOCK_SIZE_OFFSET * sizeof(int32_t), sizeof(int32_t));
-            std::reverse(vec_4bytes.begin(), vec_4bytes.end());
-            memcpy(&tm_block_size, vec_4bytes.data(), sizeof(int32_t));
-            tm_block_size *= 8;  //(in 64-bit words)
+            uint32_t frame_len = load_big_u32(ptr + HDR_FRAME_LENGTH_OFFSET * sizeof(int32_t));
+            uint32_t tm_block_size = load_big_u32(ptr + HDR_TM_BLOCK_SIZE_OFFSET * sizeof(int32_t)) * 8;  //(in 64-bit words)
+            uint32_t tm_block_num = load_big_u32(ptr + HDR_TM_BLOCK_NUM_OFFSET * sizeof(int32_t));
 
-            memcpy(vec_4bytes.data(), ptm_msg->data() + HDR_TM_BLOCK_NUM_OFFSET * sizeof(int32_t), sizeof(int32_t));
-            std::reverse(vec_4bytes.begin(), vec_4bytes.end());
-            memcpy(&tm_block_num, vec_4bytes.data(), sizeof(int32_t));
-
-            if (tm_block_num < 131072)
+            auto index = (frame_len + 7) / 8 * 8;  // ʱǩڰ64λ֡
+            //ݿϢʵʳʱֻȡĲ
+            if (tm_block_size == 0 || first_tm_block_pos + index + 8 > len)
+            {
+                tm_block_num = 0;
+            }
+            else
+            {
+                tm_block_num = std::min<uint32_t>(tm_block_num, (len - first_tm_block_pos - index - 8) / tm_block_size + 1);
+            }
+            if (tm_block_num > 0 && tm_block_num < 131072)
             {
-                //ѭȡÿһݿڵң֡
+                //һݿң֡λúʱ
+                frames.resize(tm_block_num);
                 for (uint32_t i = 0; i < tm_block_num; i++)
                 {
-                    if (!cortex_tm_parser::is_running())
-                    {
-                        break;
-                    }
-                    tm_frame_ptr pframe = std::make_shared<tm_frame>();
-                    pframe->ptm_msg = ptm_msg;
-                    pframe->frame_offset += (first_tm_block_pos + i * tm_block_size);
-                    pframe->frame_len = frame_len;
-                    auto index = std::ceil((double)pframe->frame_len / 8) * 8;
-                    auto time = parse_crtx_time(time_code_, pframe->ptm_msg->data(), pframe->frame_offset + index);
-                    tm_frame_callback_fun_(time, pframe);
+                    frames[i].offset = first_tm_block_pos + i * tm_block_size;
+                    frames[i].len = frame_len;
                 }
+                parse_crtx_times(time_code, ptr, first_tm_block_pos + index, tm_block_size, tm_block_num, [&frames](size_t i, double time) {
+                    frames[i].time = time;
+                });
             }
         }
+        return frames.size();
+    }
+
+    void hdr_tm_parser::parse_tm_msg(const tm_msg_ptr &ptm_msg)
+    {
+        if (extract_frames(ptm_msg->data(), ptm_msg->size(), time_code_, frames_) > 0 && cortex_tm_parser::is_running())
+        {
+            emit_frames(ptm_msg);
+        }
     }
 
     crt_tm_parser::crt_tm_parser(size_t capacity, int time_code)
@@ -149,23 +183,24 @@ namespace cortex
     {
     }
 
-    void crt_tm_parser::parse_tm_msg(const data_ptr ptm_msg)
+    size_t crt_tm_parser::extract_frames(const uint8_t *ptr, size_t len, int time_code, std::vector<tm_frame_desc> &frames)
+    {
+        frames.clear();
+        if (len > 17 * sizeof(int32_t))
+        {
+            uint32_t frame_len = boost::endian::load_big_u32(ptr + 10 * sizeof(int32_t));
+            auto time = parse_crtx_time(time_code, ptr, 3 * sizeof(int32_t));
+
+            frames.assign(1, { 16 * sizeof(int32_t), frame_len, time });
+        }
+        return frames.size();
+    }
+
+    void crt_tm_parser::parse_tm_msg(const tm_msg_ptr &ptm_msg)
     {
-        if (ptm_msg->size() > 17 * sizeof(int32_t))
+        if (extract_frames(ptm_msg->data(), ptm_msg->size(), time_code_, frames_) > 0)
         {
-            std::vector<uint8_t> vec_4bytes(sizeof(int32_t), 0x0);
-            uint32_t frame_len;
-            memcpy(vec_4bytes.data(), ptm_msg->data() + 10 * sizeof(int32_t), sizeof(int32_t));
-            std::reverse(vec_4bytes.begin(), vec_4bytes.end());
-            memcpy(&frame_len, vec_4bytes.data(), sizeof(int32_t));
-
-            tm_frame_ptr pframe = std::make_shared<tm_frame>();
-            pframe->ptm_msg = ptm_msg;
-            pframe->frame_offset += 16 * sizeof(int32_t);
-            pframe->frame_len = frame_len;
-
-            auto time = parse_crtx_time(time_code_, ptm_msg->data(), 3 * sizeof(int32_t));
-            tm_frame_callback_fun_(time, pframe);
+            emit_frames(ptm_msg);
         }
     }
 
@@ -7,8 +7,10 @@
 #pragma warning(disable : 4996)
 #pragma warning(disable : 4834)
 
+#include "tm_buffer_pool.h"
 #include <functional>
 #include <memory>
+#include <span>
 #include <vector>
 
 namespace cortex
@@ -21,17 +23,35 @@ namespace cortex
     class cortex_tm_parser;
     typedef std::shared_ptr<cortex_tm_parser> cortex_tm_parser_ptr;
 
-    typedef std::shared_ptr<std::vector<uint8_t>> data_ptr;
     typedef std::vector<uint8_t>::iterator iterator_type;
 
+    // ңֻ֡Ϣڵһͼ, Ϣ, ٵ
     struct tm_frame
     {
-        data_ptr ptm_msg = nullptr;
+        tm_msg_ptr ptm_msg = nullptr;
         uint32_t frame_offset = 0;
         uint32_t frame_len = 0;
+
+        const uint8_t *data() const
+        {
+            return ptm_msg->data() + frame_offset;
+        }
+        size_t size() const
+        {
+            return frame_len;
+        }
     };
-    typedef std::shared_ptr<tm_frame> tm_frame_ptr;
-    typedef std::function<void(double time, const tm_frame_ptr)> tm_frame_callback_fun_t;
+    typedef std::function<void(double time, const tm_frame &frame)> tm_frame_callback_fun_t;
+
+    // һϢһ֡λúʱ
+    struct tm_frame_desc
+    {
+        uint32_t offset;  // ֡Ϣڵƫ
+        uint32_t len;     // ֡
+        double time;      // ms
+    };
+    // һϢ֡, frames ֻڻصڼЧ, Ҫʱ ptm_msg
+    typedef std::function<void(const tm_msg_ptr &ptm_msg, std::span<const tm_frame_desc> frames)> tm_frames_callback_fun_t;
 
     class cortex_tm_parser
     {
@@ -50,9 +70,11 @@ namespace cortex
         bool is_running() const;
         void start();
         void stop();
-        void push_tm_msg(const data_ptr ptm_msg);
+        void push_tm_msg(const tm_msg_ptr &ptm_msg);
         /** ýң֡.*/
         void set_tm_frame_callback_fun(const tm_frame_callback_fun_t &fun);
+        /** ðϢң֡ĺ, ÿϢһ.*/
+        void set_tm_frames_callback_fun(const tm_frames_callback_fun_t &fun);
 
         struct buffer_status
         {
@@ -63,11 +85,15 @@ namespace cortex
         buffer_status get_buffer_status() const;
 
     protected:
-        virtual void parse_tm_msg(const data_ptr ptm_msg) = 0;
+        virtual void parse_tm_msg(const tm_msg_ptr &ptm_msg) = 0;
+        /**  frames_ ص */
+        void emit_frames(const tm_msg_ptr &ptm_msg);
 
     protected:
         int time_code_{ 0 };
         tm_frame_callback_fun_t tm_frame_callback_fun_ = nullptr;
+        tm_frames_callback_fun_t tm_frames_callback_fun_ = nullptr;
+        std::vector<tm_frame_desc> frames_;  // ֻڽ߳ʹ, ظ
 
     private:
         struct cortex_tm_parser_imp_t;
@@ -86,8 +112,11 @@ namespace cortex
         hdr_tm_parser(size_t capacity, int time_code);
         virtual ~hdr_tm_parser();
 
+        /** һ HDR Ϣң֡λúʱ, ߳, ֡ */
+        static size_t extract_frames(const uint8_t *msg, size_t len, int time_code, std::vector<tm_frame_desc> &frames);
+
     protected:
-        virtual void parse_tm_msg(const data_ptr ptm_msg) override;
+        virtual void parse_tm_msg(const tm_msg_ptr &ptm_msg) override;
     };
     /***************************************************************
      * @class crt_tm_parser
@@ -99,8 +128,11 @@ namespace cortex
         crt_tm_parser(size_t capacity, int time_code);
         virtual ~crt_tm_parser() = default;
 
+        /** һ CRT Ϣң֡λúʱ, ֡ */
+        static size_t extract_frames(const uint8_t *msg, size_t len, int time_code, std::vector<tm_frame_desc> &frames);
+
     protected:
-        virtual void parse_tm_msg(const data_ptr ptm_msg) override;
+        virtual void parse_tm_msg(const tm_msg_ptr &ptm_msg) override;
     };
     typedef std::shared_ptr<crt_tm_parser> crt_tm_parser_ptr;
 }  // namespace cortex
\ No newline at end of file
@@ -0,0 +1,350 @@
+﻿#include "cortex_udp_client.h"
+#include "sti_framer.h"
+#include <bitset>
+#include <iostream>
+#include <map>
+#include <mutex>
+#ifdef _MSC_VER
+    #define _WIN32_WINNT 0x0501
+#endif
+#include <boost/asio.hpp>
+#ifndef _WIN32
+    #include <sys/socket.h>
+#endif
+
+using boost::asio::ip::udp;
+
+namespace cortex
+{
+    // 按序号统计一个发送端的丢包、乱序和重复, 最近 WINDOW 个序号记录是否收到过
+    struct seq_tracker
+    {
+        static constexpr uint32_t WINDOW = 1024;
+        static constexpr uint32_t NEAR_ZERO = 16;      // 重启的发送端从 0 开始编号
+        static constexpr uint32_t RESTART_CONFIRM = 3;  // 连续这么多个衔接的落后报文才视为重启
+
+        void on_seq(uint32_t seq)
+        {
+            if (!started_)
+            {
+                started_ = true;
+                restart(seq);
+                return;
+            }
+            // 按 32 位回绕求出有符号距离后放宽到 64 位, 距离正好是 INT32_MIN 时取负也不会溢出
+            auto diff = int64_t(int32_t(seq - highest_));
+            if (diff > 0)
+            {
+                // 跳过的序号先记为丢失, 之后补到再减回来
+                if (diff >= (int64_t)WINDOW)
+                {
+                    seen_.reset();
+                }
+                else
+                {
+                    for (auto s = highest_ + 1; s != seq; ++s)
+                    {
+                        seen_.reset(s % WINDOW);
+                    }
+                }
+                lost_ += diff - 1;
+                highest_ = seq;
+                seen_.set(seq % WINDOW);
+                behind_ = 0;
+            }
+            else if (-diff >= (int64_t)WINDOW)
+            {
+                // 单个落后很多的报文可能只是在网络里滞留了很久, 序号接近 0 或者接连几个这样的报文前后衔接才是发送端重启
+                auto follows = behind_ > 0 && uint32_t(seq - behind_seq_) - 1 < WINDOW;
+                behind_ = follows ? behind_ + 1 : 1;
+                behind_seq_ = seq;
+                if (seq < NEAR_ZERO || behind_ >= RESTART_CONFIRM)
+                {
+                    restarts_++;
+                    restart(seq);
+                }
+                else
+                {
+                    reordered_++;
+                }
+            }
+            else if (seen_.test(seq % WINDOW))
+            {
+                duplicates_++;
+            }
+            else
+            {
+                seen_.set(seq % WINDOW);
+                reordered_++;
+                if (lost_ > 0) lost_--;
+            }
+        }
+
+        void restart(uint32_t seq)
+        {
+            highest_ = seq;
+            seen_.reset();
+            seen_.set(seq % WINDOW);
+            behind_ = 0;
+        }
+
+        bool started_ = false;
+        uint32_t highest_ = 0;
+        uint32_t behind_ = 0;      // 连续收到的落后 WINDOW 以上且彼此衔接的报文数
+        uint32_t behind_seq_ = 0;  // 其中最后一个的序号
+        std::bitset<WINDOW> seen_;
+        uint64_t lost_ = 0;
+        uint64_t reordered_ = 0;
+        uint64_t duplicates_ = 0;
+        uint64_t restarts_ = 0;
+    };
+
+    struct udp_source_t
+    {
+        std::string name_;
+        seq_tracker seq_;
+        uint64_t messages_ = 0;
+        uint64_t bytes_ = 0;
+    };
+
+    struct udp_tm_client::udp_tm_client_imp_t
+    {
+        udp_tm_client_imp_t()
+            : socket_(io_service_)
+        {
+        }
+
+        bool open()
+        {
+            boost::system::error_code ec;
+            auto addr = config_.address.empty() ? boost::asio::ip::address_v4::any() : boost::asio::ip::make_address_v4(config_.address, ec);
+            if (ec)
+            {
+                std::cerr << config_.address << ": " << ec.message() << std::endl;
+                return false;
+            }
+            socket_.open(udp::v4(), ec);
+            // 多个接收端可以绑定同一端口共享一路组播
+            socket_.set_option(udp::socket::reuse_address(true), ec);
+            socket_.set_option(boost::asio::socket_base::receive_buffer_size(config_.recv_buffer), ec);
+            socket_.bind(udp::endpoint(addr.is_multicast() ? boost::asio::ip::address_v4::any() : addr, config_.port), ec);
+            if (ec)
+            {
+                std::cerr << "bind " << config_.port << ": " << ec.message() << std::endl;
+                socket_.close(ec);
+                return false;
+            }
+            if (addr.is_multicast())
+            {
+                auto iface = config_.iface.empty() ? boost::asio::ip::address_v4::any() : boost::asio::ip::make_address_v4(config_.iface, ec);
+                socket_.set_option(boost::asio::ip::multicast::join_group(addr, iface), ec);
+                if (ec)
+                {
+                    std::cerr << "join " << config_.address << ": " << ec.message() << std::endl;
+                    socket_.close(ec);
+                    return false;
+                }
+            }
+            boost::asio::socket_base::receive_buffer_size size;
+            socket_.get_option(size, ec);
+            recv_buffer_ = size.value();
+
+            // 接收超时, 让接收线程能看到 stop
+            auto fd = socket_.native_handle();
+#ifdef _WIN32
+            DWORD timeout = 100;
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+#else
+            timeval timeout{ 0, 100 * 1000 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            // 每个报文带上内核累计丢弃的报文数
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+#endif
+            return true;
+        }
+
+        // 在 mutex_ 内调用, 一批报文只加一次锁; 只做统计, 返回是否是完整的消息, 回调在释放锁之后调用
+        bool on_datagram(uint64_t key, const udp::endpoint &from, const uint8_t *data, size_t len)
+        {
+            datagrams_++;
+            if (len < 68 || boost::endian::load_big_u32(data) != STI_HEAD || boost::endian::load_big_u32(data + 4) != len ||
+                boost::endian::load_big_u32(data + len - 4) != STI_TAIL)
+            {
+                errors_++;
+                return false;
+            }
+            auto &source = sources_[key];
+            if (source.name_.empty()) source.name_ = from.address().to_string() + ":" + std::to_string(from.port());
+            source.seq_.on_seq(boost::endian::load_big_u32(data + 20));
+            source.messages_++;
+            source.bytes_ += len;
+            return true;
+        }
+
+        void run()
+        {
+            auto batch = (size_t)std::max(config_.batch, 1);
+            auto size = config_.max_datagram;
+            std::vector<uint8_t> buf(batch * size);
+#ifdef _WIN32
+            // Windows 没有 recvmmsg, 逐个接收
+            udp::endpoint from;
+            while (is_running_)
+            {
+                boost::system::error_code ec;
+                auto len = socket_.receive_from(boost::asio::buffer(buf.data(), size), from, 0, ec);
+                if (ec) continue;
+                bool valid;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    batches_++;
+                    valid = on_datagram(((uint64_t)from.address().to_v4().to_uint() << 16) | from.port(), from, buf.data(), len);
+                }
+                if (valid && tm_msg_view_callback_fun_) tm_msg_view_callback_fun_(buf.data(), len);
+            }
+#else
+            constexpr size_t CONTROL_BYTES = CMSG_SPACE(sizeof(uint32_t));
+            std::vector<mmsghdr> msgs(batch);
+            std::vector<iovec> iovs(batch);
+            std::vector<sockaddr_in> addrs(batch);
+            std::vector<uint8_t> controls(batch * CONTROL_BYTES);
+            std::vector<char> valid(batch);
+            auto fd = socket_.native_handle();
+            while (is_running_)
+            {
+                for (size_t i = 0; i < batch; ++i)
+                {
+                    iovs[i] = { buf.data() + i * size, size };
+                    auto &hdr = msgs[i].msg_hdr;
+                    hdr = {};
+                    hdr.msg_name = &addrs[i];
+                    hdr.msg_namelen = sizeof(sockaddr_in);
+                    hdr.msg_iov = &iovs[i];
+                    hdr.msg_iovlen = 1;
+                    hdr.msg_control = controls.data() + i * CONTROL_BYTES;
+                    hdr.msg_controllen = CONTROL_BYTES;
+                }
+                // 至少等到一个报文, 之后已经排队的报文一起取走
+                auto n = recvmmsg(fd, msgs.data(), (unsigned)batch, MSG_WAITFORONE, nullptr);
+                if (n <= 0) continue;
+                std::unique_lock<std::mutex> lock(mutex_);
+                batches_++;
+                for (int i = 0; i < n; ++i)
+                {
+                    valid[i] = false;
+                    auto &hdr = msgs[i].msg_hdr;
+                    for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+                    {
+                        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+                        {
+                            uint32_t drops;
+                            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                            drops_ = drops;
+                        }
+                    }
+                    if (hdr.msg_flags & MSG_TRUNC)
+                    {
+                        datagrams_++;
+                        errors_++;
+                        continue;
+                    }
+                    auto &addr = addrs[i];
+                    udp::endpoint from(boost::asio::ip::address_v4(ntohl(addr.sin_addr.s_addr)), ntohs(addr.sin_port));
+                    valid[i] = on_datagram(((uint64_t)ntohl(addr.sin_addr.s_addr) << 16) | ntohs(addr.sin_port), from, buf.data() + i * size, msgs[i].msg_len);
+                }
+                lock.unlock();
+
+                // 回调不持锁, 回调里处理得再久也不会挡住 get_status
+                if (!tm_msg_view_callback_fun_) continue;
+                for (int i = 0; i < n; ++i)
+                {
+                    if (valid[i]) tm_msg_view_callback_fun_(buf.data() + i * size, msgs[i].msg_len);
+                }
+            }
+#endif
+        }
+
+        udp_tm_config config_;
+        boost::asio::io_service io_service_;
+        udp::socket socket_;
+        std::thread thread_;
+        std::atomic_bool is_running_ = false;
+        tm_msg_view_callback_fun_t tm_msg_view_callback_fun_ = nullptr;
+        int recv_buffer_ = 0;
+
+        mutable std::mutex mutex_;  // 保护以下统计, 接收线程每批报文加一次锁
+        std::map<uint64_t, udp_source_t> sources_;
+        uint64_t datagrams_ = 0;
+        uint64_t batches_ = 0;
+        uint64_t errors_ = 0;
+        uint64_t drops_ = 0;
+    };
+
+    udp_tm_client::udp_tm_client()
+        : imp_(new udp_tm_client_imp_t)
+    {
+    }
+
+    udp_tm_client::~udp_tm_client()
+    {
+        stop();
+    }
+
+    void udp_tm_client::set_config(const udp_tm_config &config)
+    {
+        imp_->config_ = config;
+    }
+
+    udp_tm_config udp_tm_client::get_config() const
+    {
+        return imp_->config_;
+    }
+
+    void udp_tm_client::set_tm_msg_view_callback_fun(const tm_msg_view_callback_fun_t &fun)
+    {
+        imp_->tm_msg_view_callback_fun_ = fun;
+    }
+
+    bool udp_tm_client::is_running() const
+    {
+        return imp_->is_running_;
+    }
+
+    bool udp_tm_client::start()
+    {
+        if (imp_->is_running_) return true;
+        if (!imp_->open()) return false;
+        imp_->is_running_ = true;
+        imp_->thread_ = std::thread([this]() {
+            imp_->run();
+        });
+        return true;
+    }
+
+    void udp_tm_client::stop()
+    {
+        if (imp_->is_running_)
+        {
+            imp_->is_running_ = false;
+            if (imp_->thread_.joinable())
+            {
+                imp_->thread_.join();
+            }
+            boost::system::error_code ec;
+            imp_->socket_.close(ec);
+        }
+    }
+
+    udp_tm_client::status udp_tm_client::get_status() const
+    {
+        std::lock_guard<std::mutex> lock(imp_->mutex_);
+        status result{ imp_->datagrams_, imp_->batches_, imp_->errors_, imp_->drops_, imp_->recv_buffer_, {} };
+        for (auto &pair : imp_->sources_)
+        {
+            auto &s = pair.second;
+            result.sources.push_back({ s.name_, s.messages_, s.bytes_, s.seq_.lost_, s.seq_.reordered_, s.seq_.duplicates_, s.seq_.restarts_ });
+        }
+        return result;
+    }
+}  // namespace cortex
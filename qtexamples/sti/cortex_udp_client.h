@@ -0,0 +1,70 @@
+﻿// Description: Provide a UDP/multicast client to receive telemetry messages
+
+#pragma once
+#pragma warning(disable : 4251)
+
+#include "cortex_sti_parser.h"
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace cortex
+{
+    struct udp_tm_config
+    {
+        std::string address;                 // 组播地址, 或空/本机地址表示接收单播
+        uint16_t port = 0;
+        std::string iface;                   // 加入组播的本机网卡地址, 空表示系统默认
+        int recv_buffer = 16 * 1024 * 1024;  // SO_RCVBUF, 收得慢时先在内核里排队
+        int batch = 64;                      // 一次 recvmmsg 最多收的报文数
+        size_t max_datagram = 65536;
+    };
+
+    /***************************************************************
+     * @class udp_tm_client
+     * @brief 接收 tm_server::add_udp_target 发出的 CRT 消息, 一个报文一个消息, 不需要组包.
+     * @note  多个接收端可以绑定同一端口共享一路组播; 按发送端(地址:端口)用消息头的序号统计丢包、乱序和重复.
+     *        消息回调在接收线程里调用, 指向接收缓存, 只在回调期间有效.
+     ***************************************************************/
+    class udp_tm_client
+    {
+    public:
+        udp_tm_client();
+        virtual ~udp_tm_client();
+
+        void set_config(const udp_tm_config &config);
+        udp_tm_config get_config() const;
+        void set_tm_msg_view_callback_fun(const tm_msg_view_callback_fun_t &fun);
+
+        bool is_running() const;
+        /** 打开套接字并开始接收, 绑定或加入组播失败返回 false */
+        bool start();
+        void stop();
+
+        struct source_status
+        {
+            std::string source;   // 发送端地址:端口
+            uint64_t messages;    // 收到的消息数
+            uint64_t bytes;
+            uint64_t lost;        // 序号缺失且之后没有补到的消息数
+            uint64_t reordered;   // 晚于后面序号到达的消息数
+            uint64_t duplicates;  // 重复的消息数
+            uint64_t restarts;    // 序号回退很多, 视为发送端重启
+        };
+        struct status
+        {
+            uint64_t datagrams;   // 收到的报文数
+            uint64_t batches;     // 接收调用次数, datagrams / batches 即每次批量收到的报文数
+            uint64_t errors;      // 格式错误或截断的报文数
+            uint64_t drops;       // 套接字接收队列满被内核丢弃的报文数(Linux SO_RXQ_OVFL)
+            int recv_buffer;      // 实际生效的 SO_RCVBUF
+            std::vector<source_status> sources;
+        };
+        status get_status() const;
+
+    private:
+        struct udp_tm_client_imp_t;
+        std::shared_ptr<udp_tm_client_imp_t> imp_;
+    };
+    typedef std::shared_ptr<udp_tm_client> udp_tm_client_ptr;
+}  // namespace cortex
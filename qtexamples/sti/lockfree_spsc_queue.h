@@ -5,22 +5,176 @@
 #pragma once
 #pragma warning(disable : 4996)
 
-#include <boost/lockfree/spsc_queue.hpp>
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
-#include <iostream>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
 #include <vector>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#endif
 
-template <class T>
+/* Wait strategies for lockfree_spsc_queue.
+ * The queue keeps one instance for the consumer (waiting for data) and one for the producer (waiting for space):
+ *   wait(ready)  blocks until ready() is true
+ *   notify()     called by the other side after it publishes, must be cheap when nobody waits
+ *   notify_all() called by quit(), must wake a sleeper unconditionally
+ */
+namespace spsc_wait
+{
+    inline void cpu_pause()
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    /** spins with pause, lowest latency, burns a core while idle */
+    struct busy_spin
+    {
+        template <class Ready>
+        void wait(Ready ready)
+        {
+            while (!ready())
+            {
+                cpu_pause();
+            }
+        }
+        void notify()
+        {
+        }
+        void notify_all()
+        {
+        }
+    };
+
+    /** spins for a while, then yields the time slice on every check */
+    template <int SPINS = 1024>
+    struct spin_yield
+    {
+        template <class Ready>
+        void wait(Ready ready)
+        {
+            for (int i = 0; !ready(); ++i)
+            {
+                if (i < SPINS)
+                {
+                    cpu_pause();
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        void notify()
+        {
+        }
+        void notify_all()
+        {
+        }
+    };
+
+    /** spins for a while, then parks on std::atomic::wait; the other side only notifies while the sleeping flag is set */
+    template <int SPINS = 1024>
+    struct spin_park
+    {
+        template <class Ready>
+        void wait(Ready ready)
+        {
+            for (int i = 0; i < SPINS; ++i)
+            {
+                if (ready()) return;
+                cpu_pause();
+            }
+            while (true)
+            {
+                // read the sequence before raising the flag: a notify that saw the flag always changes it
+                auto seq = seq_.load(std::memory_order_acquire);
+                sleeping_.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (ready()) break;
+                seq_.wait(seq, std::memory_order_acquire);
+            }
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+        void notify()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping_.load(std::memory_order_relaxed))
+            {
+                notify_all();
+            }
+        }
+        void notify_all()
+        {
+            seq_.fetch_add(1, std::memory_order_release);
+            seq_.notify_all();
+        }
+
+    private:
+        std::atomic<uint32_t> seq_{ 0 };
+        std::atomic_bool sleeping_{ false };
+    };
+
+    /* sleeps on a condition variable at once.
+     * The waiter raises its flag before re-checking under the mutex, the other side publishes before reading
+     * the flag (both fenced), so either the waiter sees the new data or the other side notifies under the mutex.
+     */
+    struct blocking
+    {
+        template <class Ready>
+        void wait(Ready ready)
+        {
+            if (ready()) return;
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            condition_.wait(lock, ready);
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+        void notify()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping_.load(std::memory_order_relaxed))
+            {
+                notify_all();
+            }
+        }
+        void notify_all()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.notify_all();
+        }
+
+    private:
+        std::atomic_bool sleeping_{ false };
+        std::mutex mutex_;
+        std::condition_variable condition_;
+    };
+}  // namespace spsc_wait
+
+/** single producer, single consumer ring
+ * @tparam Wait how pop / read_span / push_wait wait, see spsc_wait; blocking keeps the old behaviour
+ */
+template <class T, class Wait = spsc_wait::blocking>
 class lockfree_spsc_queue
 {
 public:
     /** Constructs a spsc_queue for element_count elements
      *
-     *  \pre spsc_queue must be configured to be sized at run-time
+     *  \note the ring is a single array, contiguous regions are exposed by write_span / read_span
      */
     lockfree_spsc_queue(std::size_t element_count)
-        : capacity_(element_count)
-        , spsc_queue_(element_count)
+        : capacity_(std::max<size_t>(element_count, 1))
+        , ring_(new T[capacity_]())
     {
     }
     virtual ~lockfree_spsc_queue() = default;
@@ -36,13 +190,11 @@ public:
      * */
     bool push(T const &t)
     {
-        bool ret = spsc_queue_.push(t);
-        if (ret)
-        {
-            used_size_++;
-        }
-        condition_.notify_one();
-        return ret;
+        auto span = write_span(1);
+        if (span.empty()) return false;
+        span[0] = t;
+        commit(1);
+        return true;
     }
     /** Pushes as many objects from the range [begin, end) as there is space .
      *
@@ -54,10 +206,19 @@ public:
     template <typename ElementIterator>
     ElementIterator push(ElementIterator begin, ElementIterator end)
     {
-        auto iter = spsc_queue_.push(begin, end);
-        used_size_ += iter - begin;
-        condition_.notify_one();
-        return iter;
+        // at most two contiguous regions: up to the end of the ring, then from its start
+        size_t pushed = 0;
+        for (int i = 0; i < 2 && begin != end; ++i)
+        {
+            auto span = write_span(std::distance(begin, end));
+            if (span.empty()) break;
+            std::copy_n(begin, span.size(), span.begin());
+            begin += span.size();
+            pushed += span.size();
+            tail_.store(tail_.load(std::memory_order_relaxed) + span.size(), std::memory_order_release);
+        }
+        if (pushed > 0) consumer_wait_.notify();
+        return begin;
     }
 
     /** Pushes object t to the ringbuffer.
@@ -68,56 +229,148 @@ public:
      * */
     void push_wait(const T &t)
     {
-        while (!quit_ && !spsc_queue_.push(t))
+        while (!quit_ && !push(t))
         {
-            std::unique_lock<std::mutex> lock(mutex_);
-            condition_.wait(lock);
+            producer_wait_.wait([this] {
+                return quit_ || used_size() < capacity_;
+            });
+        }
+    }
+
+    /** Contiguous free slots at the write position, at most n.
+     *
+     * \pre only one thread is allowed to write to the spsc_queue.
+     * \return may be shorter than the free space when it wraps around the end of the ring, empty when full.
+     *
+     * \note fill the slots in place, then publish them with commit()
+     * */
+    std::span<T> write_span(size_t n = SIZE_MAX)
+    {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        auto free = capacity_ - (tail - head_cache_);
+        if (free < n)
+        {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            free = capacity_ - (tail - head_cache_);
+        }
+        auto index = tail % capacity_;
+        return { ring_.get() + index, std::min({ n, free, capacity_ - index }) };
+    }
+
+    /** Contiguous free slots at the write position, waits while the ring is full.
+     *
+     * \pre only one thread is allowed to write to the spsc_queue.
+     * \return empty after quit()
+     *
+     * \note lets a reader fill the ring straight from a socket and leave the flow control to the sender
+     * */
+    std::span<T> write_span_wait(size_t n = SIZE_MAX)
+    {
+        auto span = write_span(n);
+        while (span.empty() && n > 0 && !quit_)
+        {
+            producer_wait_.wait([this] {
+                return quit_ || used_size() < capacity_;
+            });
+            span = write_span(n);
+        }
+        return span;
+    }
+
+    /** Publishes n slots filled through write_span(). */
+    void commit(size_t n)
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        consumer_wait_.notify();
+    }
+
+    /** Contiguous readable items at the read position.
+     *
+     * \pre only one thread is allowed to read from the spsc_queue.
+     * \param min wait until at least min items are available in total (not necessarily contiguous)
+     * \return may hold fewer than min when the items wrap around the end of the ring, empty after quit().
+     *
+     * \note the items stay in the ring until consume()
+     * */
+    std::span<T> read_span(size_t min = 1, bool wait = true)
+    {
+        min = std::min(min, capacity_);
+        if (wait && read_available() < min)
+        {
+            consumer_wait_.wait([this, min] {
+                return quit_ || read_available() >= min;
+            });
         }
-        used_size_++;
-        condition_.notify_one();
+        auto head = head_.load(std::memory_order_relaxed);
+        auto used = tail_.load(std::memory_order_acquire) - head;
+        auto index = head % capacity_;
+        return { ring_.get() + index, std::min(used, capacity_ - index) };
+    }
+
+    /** Releases n items returned by read_span(). */
+    void consume(size_t n)
+    {
+        auto head = head_.load(std::memory_order_relaxed);
+        if constexpr (!std::is_trivially_copyable_v<T>)
+        {
+            // drop what the items hold (e.g. shared buffers) now rather than when the slot is reused
+            for (size_t i = 0; i < n; ++i)
+            {
+                ring_[(head + i) % capacity_] = T();
+            }
+        }
+        head_.store(head + n, std::memory_order_release);
+        producer_wait_.notify();
     }
 
     /** Pops a maximum of size objects from ringbuffer.
      *
      * \pre only one thread is allowed to pop data to the spsc_queue.
-     * \return number of popped items
+     * \return all popped items
      *
      * \note Thread-safe and wait when the spsc_queue is empty.
+     *       Allocates a vector on every call, prefer read_span() / consume() on hot paths.
      * */
     std::shared_ptr<std::vector<T>> pop(bool wait = true)
     {
-        if (wait && spsc_queue_.empty())
+        return pop(wait ? 1 : 0, SIZE_MAX);
+    }
+
+    /** Pops a maximum of max objects from ringbuffer into out.
+     *
+     * \pre only one thread is allowed to pop data to the spsc_queue.
+     * \return number of popped items
+     *
+     * \note Thread-safe and wait when the spsc_queue is empty.
+     * */
+    size_t pop(T *out, size_t max, bool wait = true)
+    {
+        if (wait) read_span(1, true);
+        size_t popped = 0;
+        for (int i = 0; i < 2 && popped < max; ++i)
         {
-            std::unique_lock<std::mutex> lock(mutex_);
-            condition_.wait(lock);
+            auto span = read_span(0, false);
+            auto n = std::min(span.size(), max - popped);
+            if (n == 0) break;
+            std::move(span.begin(), span.begin() + n, out + popped);
+            consume(n);
+            popped += n;
         }
-        auto pop_size = spsc_queue_.read_available();
-        auto pop_data = std::make_shared<std::vector<T>>(pop_size);
-        spsc_queue_.pop(pop_data->data(), pop_size);
-        used_size_ -= pop_size;
-        condition_.notify_one();
-        return pop_data;
+        return popped;
     }
 
     /** Pops a range-size objects from ringbuffer.
      *
      * \pre only one thread is allowed to pop data to the spsc_queue.\
-     * \return number of popped items
+     * \return popped items
      *
      * \note Thread-safe and wait when the spsc_queue is less than min.
      * */
     std::shared_ptr<std::vector<T>> pop(size_t min, size_t max)
     {
-        while (!quit_ && spsc_queue_.read_available() < min)
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
-            condition_.wait(lock);
-        }
-        auto pop_size = std::min(max, spsc_queue_.read_available());
-        auto pop_data = std::make_shared<std::vector<T>>(pop_size);
-        spsc_queue_.pop(pop_data->data(), pop_size);
-        used_size_ -= pop_size;
-        condition_.notify_one();
+        if (min > 0) read_span(min, true);
+        auto pop_data = std::make_shared<std::vector<T>>(std::min(max, read_available()));
+        pop_data->resize(pop(pop_data->data(), pop_data->size(), false));
         return pop_data;
     }
 
@@ -128,29 +381,48 @@ public:
     }
     size_t used_size() const
     {
-        return used_size_;
+        // head first: tail only grows, so the difference never goes negative
+        auto head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+    size_t read_available() const
+    {
+        return used_size();
+    }
+    bool empty() const
+    {
+        return used_size() == 0;
     }
 
     void quit()
     {
-        std::unique_lock<std::mutex> lock(mutex_);
         quit_ = true;
-        condition_.notify_all();
+        consumer_wait_.notify_all();
+        producer_wait_.notify_all();
     }
 
     // note Not thread-safe
     void reset()
     {
-        used_size_ = 0;
         quit_ = false;
-        spsc_queue_.reset();
+        if constexpr (!std::is_trivially_copyable_v<T>)
+        {
+            std::fill_n(ring_.get(), capacity_, T());
+        }
+        head_ = tail_ = 0;
+        head_cache_ = 0;
     }
 
 private:
-    std::atomic<size_t> capacity_;
-    std::atomic<size_t> used_size_ = 0;
-    std::atomic_bool quit_ = false;
-    std::mutex mutex_;
-    std::condition_variable condition_;
-    boost::lockfree::spsc_queue<T> spsc_queue_;
-};
\ No newline at end of file
+    const size_t capacity_;
+    std::unique_ptr<T[]> ring_;
+
+    // head_/tail_ only grow, the slot is index % capacity_
+    alignas(64) std::atomic<size_t> head_{ 0 };  // written by the consumer
+    alignas(64) std::atomic<size_t> tail_{ 0 };  // written by the producer
+    size_t head_cache_{ 0 };                     // producer's last view of head_
+
+    alignas(64) std::atomic_bool quit_ = false;
+    alignas(64) Wait consumer_wait_;  // consumer waits for data
+    alignas(64) Wait producer_wait_;  // producer waits for space
+};
@@ -0,0 +1,200 @@
+// Description: Paces a sender at a fixed frame rate on absolute deadlines
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#endif
+
+/**
+ * Releases one frame per period on absolute deadlines t0 + n * period, so the rate does not drift with the time the caller
+ * spends between waits. Sleeps until shortly before the deadline and spins the rest to get below the timer granularity.
+ *
+ *   rate_pacer pacer(100.0);                  // minor frames per second
+ *   while (running) { pacer.wait(); send(); }
+ *
+ * Not thread-safe: wait() and get_stats() are called from the sending thread.
+ * std::min/max are parenthesised because this header is used next to <windows.h>.
+ */
+class rate_pacer
+{
+public:
+    struct options
+    {
+        double rate = 100.0;                              // frames per second
+        std::chrono::nanoseconds spin{ 100'000 };         // spin this long before each deadline, 0 sleeps all the way
+        std::chrono::nanoseconds max_lag{ 100'000'000 };  // further behind than this the schedule restarts instead of bursting
+        size_t jitter_samples = 4096;                     // intervals kept for the percentiles
+    };
+
+    struct stats
+    {
+        uint64_t frames;      // released since start()
+        double rate;          // achieved frames per second
+        double jitter_p50_us; // |interval - period|
+        double jitter_p99_us;
+        double jitter_max_us;
+        uint64_t resyncs;     // times the schedule restarted after falling behind more than max_lag
+    };
+
+    explicit rate_pacer(const options &opts)
+        : opts_(opts)
+        , period_ns_(int64_t(1e9 / (std::max)(opts.rate, 1e-3)))
+    {
+        intervals_.reserve(opts_.jitter_samples);
+#ifdef _WIN32
+        timer_ = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!timer_) timer_ = CreateWaitableTimerW(nullptr, TRUE, nullptr);
+#endif
+        start();
+    }
+    explicit rate_pacer(double rate)
+        : rate_pacer(options{ rate })
+    {
+    }
+    /** frames of frame_bytes sent on a link of bits_per_second */
+    static options bit_rate(double bits_per_second, size_t frame_bytes)
+    {
+        return options{ bits_per_second / 8 / (std::max)(frame_bytes, size_t(1)) };
+    }
+    ~rate_pacer()
+    {
+#ifdef _WIN32
+        if (timer_) CloseHandle(timer_);
+#endif
+    }
+    rate_pacer(const rate_pacer &) = delete;
+    rate_pacer &operator=(const rate_pacer &) = delete;
+
+    int64_t period_ns() const
+    {
+        return period_ns_;
+    }
+
+    /** restarts the schedule, the first wait() returns at once */
+    void start()
+    {
+        t0_ = now_ns();
+        next_ = t0_;
+        last_ = 0;
+        frames_ = 0;
+        resyncs_ = 0;
+        intervals_.clear();
+        cursor_ = 0;
+    }
+
+    /** blocks until the next frame is due */
+    void wait()
+    {
+        auto now = now_ns();
+        if (now - next_ > opts_.max_lag.count())
+        {
+            // stalled (debugger, suspended machine): catching up would send a burst no real link produces
+            next_ = now;
+            last_ = 0;
+            resyncs_++;
+        }
+        auto wake = next_ - opts_.spin.count();
+        if (wake > now) sleep_until(wake);
+        while ((now = now_ns()) < next_)
+        {
+            pause();
+        }
+
+        if (last_ != 0) record(now - last_);
+        last_ = now;
+        frames_++;
+        next_ += period_ns_;
+    }
+
+    stats get_stats() const
+    {
+        auto sorted = intervals_;
+        std::sort(sorted.begin(), sorted.end());
+        auto pct = [&sorted](double p) {
+            return sorted.empty() ? 0.0 : sorted[(std::min)(sorted.size() - 1, size_t(p * sorted.size()))] / 1e3;
+        };
+        auto elapsed = (last_ - t0_) / 1e9;
+        return stats{ frames_, elapsed > 0 && frames_ > 1 ? (frames_ - 1) / elapsed : 0.0, pct(0.5), pct(0.99),
+            sorted.empty() ? 0.0 : sorted.back() / 1e3, resyncs_ };
+    }
+
+private:
+    static int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void pause()
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    void sleep_until(int64_t deadline_ns)
+    {
+#ifdef _WIN32
+        // waitable timers only take system-clock absolute times, use the remaining steady time as a relative due time
+        auto remain = deadline_ns - now_ns();
+        if (remain <= 0) return;
+        if (timer_)
+        {
+            LARGE_INTEGER due;
+            due.QuadPart = -(std::max)(remain / 100, int64_t(1));  // 100 ns units, negative = relative
+            if (SetWaitableTimer(timer_, &due, 0, nullptr, nullptr, FALSE))
+            {
+                WaitForSingleObject(timer_, INFINITE);
+                return;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(remain));
+#else
+        // steady_clock is CLOCK_MONOTONIC on Linux, an absolute deadline does not accumulate wakeup latency
+        timespec ts{ time_t(deadline_ns / 1'000'000'000), long(deadline_ns % 1'000'000'000) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+        {
+        }
+#endif
+    }
+
+    void record(int64_t interval)
+    {
+        auto jitter = interval > period_ns_ ? interval - period_ns_ : period_ns_ - interval;
+        if (intervals_.size() < opts_.jitter_samples)
+        {
+            intervals_.push_back(jitter);
+        }
+        else if (!intervals_.empty())
+        {
+            intervals_[cursor_++ % intervals_.size()] = jitter;
+        }
+    }
+
+private:
+    options opts_;
+    int64_t period_ns_;
+    int64_t t0_{ 0 };
+    int64_t next_{ 0 };  // deadline of the next frame
+    int64_t last_{ 0 };  // release time of the previous frame
+    uint64_t frames_{ 0 };
+    uint64_t resyncs_{ 0 };
+    std::vector<int64_t> intervals_;  // jitter of the last jitter_samples intervals, ns
+    size_t cursor_{ 0 };
+#ifdef _WIN32
+    HANDLE timer_{ nullptr };
+#endif
+};
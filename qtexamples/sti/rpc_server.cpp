@@ -1,4 +1,11 @@
 #include "rpc_server.h"
+#include "lockfree_spsc_queue.h"
+#include "sti_framer.h"
+#include <algorithm>
+#include <boost/asio/thread_pool.hpp>
+#include <map>
+#include <mutex>
+#include <thread>
 
 template <class T>
 inline constexpr T SwapEndian32(T src)
@@ -6,195 +13,295 @@ inline constexpr T SwapEndian32(T src)
     return 0 | ((src & 0x000000ff) << 24) | ((src & 0x0000ff00) << 8) | ((src & 0x00ff0000) >> 8) | ((src & 0xff000000) >> 24);
 }
 
-rpc_server::rpc_server()
-    : readBuf_(new std::vector<uint8_t>(1500))
-    , parseBuf_(new std::vector<uint8_t>(1500))
+const static size_t READ_RING_BYTES = 64 * 1024;  // ÿͻ˵Ľջλ, ֱӶ, ڻ
+const static size_t MIN_REQUEST_BYTES = 20;       // һϢͷ5(β)
+const static size_t DATA_OFFSET = 5 * sizeof(int);
+
+static thread_local int current_client = -1;  // ǰ߳ڻصĸͻ
+
+static size_t default_threads(size_t threads)
+{
+    return threads ? threads : std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+}
+
+//һͻ: հӦڸӵ strand , xfer ص̳߳ص strand ϰ˳ִ
+struct rpc_client
+{
+    rpc_client(int id, sock_ptr socket, boost::asio::thread_pool &pool)
+        : id_(id)
+        , socket_(socket)
+        , strand_(boost::asio::make_strand(socket->get_executor()))
+        , work_(boost::asio::make_strand(pool))
+        , ring_(READ_RING_BYTES)
+    {
+    }
+
+    const int id_;
+    sock_ptr socket_;
+    std::string peer_;
+    boost::asio::strand<boost::asio::any_io_executor> strand_;
+    boost::asio::strand<boost::asio::thread_pool::executor_type> work_;
+
+    // ֻ strand_ ʹ
+    lockfree_spsc_queue<uint8_t, spsc_wait::busy_spin> ring_;  // ͽ strand , Ӳȴ
+    cortex::sti_stream_framer framer_;
+    std::vector<uint8_t> out_;      // ŶӵӦ
+    std::vector<uint8_t> sending_;  // ڷ͵Ӧ,  out_ ʹ
+    std::vector<std::pair<int, data_ptr>> batch_;  // ζ, Ӧ𷢳һ𽻸̳߳
+    bool writing_ = false;
+    bool closed_ = false;
+
+    std::atomic_uint64_t requests_ = 0;
+    std::atomic_uint64_t errors_ = 0;
+    std::atomic_uint64_t pending_ = 0;
+    std::atomic_uint64_t replied_ = 0;
+    std::atomic_uint64_t writes_ = 0;
+};
+using rpc_client_ptr = std::shared_ptr<rpc_client>;
+
+struct rpc_server::rpc_server_impl : std::enable_shared_from_this<rpc_server_impl>
 {
-    parseBuf_->reserve(1500);
-    tcp_server::bind_new_connection_handler([&](sock_ptr socket) {
-        if (client_)
+    rpc_server_impl(size_t workers)
+        : pool_(workers)
+    {
+    }
+
+    boost::asio::thread_pool pool_;
+    xfer_client_handler xfer_;  // start ֮ǰ, ֻ֮
+    mutable std::mutex mutex_;  // ֻͻ˱
+    std::map<int, rpc_client_ptr> clients_;
+    int next_id_ = 0;
+
+    void add(sock_ptr socket)
+    {
+        boost::system::error_code ec;
+        //ӦѾϲ, Nagle ֻòһĶεӦȴԶ˵ӳȷ
+        socket->set_option(boost::asio::ip::tcp::no_delay(true), ec);
+        auto ep = socket->remote_endpoint(ec);
+        rpc_client_ptr client;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            client = std::make_shared<rpc_client>(next_id_++, socket, pool_);
+            client->peer_ = ec ? std::string() : ep.address().to_string() + ":" + std::to_string(ep.port());
+            clients_[client->id_] = client;
+        }
+        boost::asio::post(client->strand_, [self = shared_from_this(), client] {
+            self->do_read(client);
+        });
+    }
+
+    rpc_client_ptr find(int id) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = clients_.find(id);
+        return iter == clients_.end() ? nullptr : iter->second;
+    }
+
+    void do_read(const rpc_client_ptr &client)
+    {
+        //ֱӶ뻷λĿж, ʣĲϢҪŲ濪ͷ
+        auto span = client->ring_.write_span();
+        client->socket_->async_read_some(boost::asio::buffer(span.data(), span.size()),
+            boost::asio::bind_executor(client->strand_, [self = shared_from_this(), client](auto &&ec, size_t n) {
+                self->on_read(client, ec, n);
+            }));
+    }
+
+    void on_read(const rpc_client_ptr &client, const boost::system::error_code &ec, size_t n)
+    {
+        if (ec)
+        {
+            close(client);
+            return;
+        }
+        client->ring_.commit(n);
+        auto on_msg = [this, &client](const uint8_t *msg, size_t len) {
+            on_request(client, msg, len);
+        };
+        while (client->framer_.step(client->ring_, on_msg, client->errors_))
+        {
+        }
+        //ζӦһ, ȷӦٻѹ߳
+        flush(client);
+        dispatch(client);
+        do_read(client);
+    }
+
+    void on_request(const rpc_client_ptr &client, const uint8_t *msg, size_t len)
+    {
+        client->requests_++;
+        //Ӧ: ͷ, , , ״̬, β; ԭ
+        int ack[5] = { SwapEndian32(1234567890), SwapEndian32(20), 0, SwapEndian32(0), SwapEndian32(-1234567890) };
+        memcpy(&ack[2], msg + 8, sizeof(int));
+        if (len < MIN_REQUEST_BYTES)
+        {
+            client->errors_++;
+            ack[3] = SwapEndian32(1);  // Bad syntax
+            reply(client, ack, sizeof(ack));
             return;
-        client_ = socket;
-        check_connection();
+        }
+        reply(client, ack, sizeof(ack));
+        if (!xfer_) return;
+
+        int type, dlen;
+        memcpy(&type, msg + 12, sizeof(int));
+        memcpy(&dlen, msg + 16, sizeof(int));
+        type = SwapEndian32(type);
+        auto size = std::min<size_t>((unsigned)SwapEndian32(dlen), len - DATA_OFFSET - 4);  //ݳȲϢ
+        client->batch_.emplace_back(type, std::make_shared<std::vector<uint8_t>>(msg + DATA_OFFSET, msg + DATA_OFFSET + size));
+    }
+
+    void dispatch(const rpc_client_ptr &client)
+    {
+        if (client->batch_.empty()) return;
+        client->pending_ += client->batch_.size();
+        boost::asio::post(client->work_, [this, client, batch = std::move(client->batch_)] {
+            current_client = client->id_;
+            for (auto &request : batch)
+            {
+                xfer_(client->id_, request.first, request.second);
+                client->pending_--;
+            }
+            current_client = -1;
+        });
+        client->batch_.clear();
+    }
+
+    //  strand ϵ
+    void reply(const rpc_client_ptr &client, const void *data, size_t len)
+    {
+        auto ptr = (const uint8_t *)data;
+        client->out_.insert(client->out_.end(), ptr, ptr + len);
+    }
+
+    void flush(const rpc_client_ptr &client)
+    {
+        if (client->writing_ || client->closed_ || client->out_.empty()) return;
+        client->writing_ = true;
+        std::swap(client->out_, client->sending_);
+        client->out_.clear();
+        client->writes_++;
+        boost::asio::async_write(*client->socket_, boost::asio::buffer(client->sending_),
+            boost::asio::bind_executor(client->strand_, [self = shared_from_this(), client](auto &&ec, size_t n) {
+                client->writing_ = false;
+                if (ec)
+                {
+                    self->close(client);
+                    return;
+                }
+                client->replied_ += n;
+                self->flush(client);
+            }));
+    }
+
+    void close(const rpc_client_ptr &client)
+    {
+        if (client->closed_) return;
+        client->closed_ = true;
+        boost::system::error_code ec;
+        client->socket_->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+        client->socket_->close(ec);
+        std::lock_guard<std::mutex> lock(mutex_);
+        clients_.erase(client->id_);
+    }
+};
+
+rpc_server::rpc_server(size_t threads, size_t workers)
+    : tcp_server(default_threads(threads))
+    , impl_(new rpc_server_impl(default_threads(workers)))
+{
+    tcp_server::bind_new_connection_handler([this](sock_ptr socket) {
+        impl_->add(socket);
     });
 }
 
 rpc_server::~rpc_server()
 {
+    stop();
+    //صõ impl_, ȹ߳̽
+    impl_->pool_.join();
 }
 
 void rpc_server::stop()
 {
     tcp_server::stop();
     //ֹͣʱͷԴ
-    if (client_ && client_->is_open())
+    std::map<int, rpc_client_ptr> clients;
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        clients.swap(impl_->clients_);
+    }
+    for (auto &pair : clients)
     {
-        client_->cancel();
+        auto &client = pair.second;
+        boost::asio::post(client->strand_, [impl = impl_, client] {
+            impl->close(client);
+        });
     }
 }
 
+void rpc_server::bind_xfer_handler(const xfer_handler &handler)
+{
+    impl_->xfer_ = handler ? [handler](int, int type, data_ptr data) { handler(type, data); } : xfer_client_handler();
+}
+
+void rpc_server::bind_xfer_handler(const xfer_client_handler &handler)
+{
+    impl_->xfer_ = handler;
+}
+
 void rpc_server::response(int type, const data_ptr data)
 {
+    if (current_client >= 0)
+    {
+        response(current_client, type, data);
+        return;
+    }
+    std::vector<int> ids;
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        for (auto &pair : impl_->clients_)
+        {
+            ids.push_back(pair.first);
+        }
+    }
+    for (auto id : ids)
+    {
+        response(id, type, data);
+    }
+}
+
+void rpc_server::response(int client, int type, const data_ptr data)
+{
+    auto target = impl_->find(client);
+    if (!target) return;
+
     int byteAligned = 4;
     int offsetNum = std::ceil((double)data->size() / byteAligned);
     //ظϢ
     std::vector<int> replyMsg(6 + offsetNum);
     replyMsg[0] = SwapEndian32(1234567890);
     replyMsg[1] = SwapEndian32(replyMsg.size() * 4);
-    replyMsg[4] = SwapEndian32(-1234567890);
     replyMsg[2] = SwapEndian32(1);
     replyMsg[3] = SwapEndian32(type);
     replyMsg[4] = SwapEndian32(int(data->size()));
     memcpy(&replyMsg[5], data->data(), data->size());
     replyMsg[6 + offsetNum - 1] = SwapEndian32(-1234567890);
-    client_->write_some(boost::asio::buffer(replyMsg));
-}
-
-void rpc_server::check_connection()
-{
-    client_->async_read_some(boost::asio::buffer(*readBuf_),
-        boost::bind(&rpc_server::read_handler, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
-}
-
-inline int get_value(const uint8_t *v)
-{
-    return *reinterpret_cast<const int *>(v);
+    //ÿͻ˵Ӧ, Ӧϲ
+    boost::asio::post(target->strand_, [impl = impl_, target, replyMsg = std::move(replyMsg)] {
+        impl->reply(target, replyMsg.data(), replyMsg.size() * sizeof(int));
+        impl->flush(target);
+    });
 }
 
-void rpc_server::read_handler(const boost::system::error_code &ec, size_t bytes_transferred)
+std::vector<rpc_server::client_status> rpc_server::get_client_status() const
 {
-    constexpr int head = SwapEndian32(1234567890);
-    constexpr int tail = SwapEndian32(-1234567890);
-    if (ec)
+    std::vector<client_status> result;
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    for (auto &pair : impl_->clients_)
     {
-        if (client_->is_open())
-        {
-            client_->shutdown(boost::asio::ip::tcp::socket::shutdown_both);
-            client_->close();
-        }
-        client_ = nullptr;
-    }
-    else
-    {
-        if (bytes_transferred > 0)
-        {
-            //ĩβ
-            size_t size = parseBuf_->size();
-            parseBuf_->resize(size + bytes_transferred);
-            memcpy(parseBuf_->data() + size, readBuf_->data(), bytes_transferred);
-
-            size_t offset = 0;
-            size = parseBuf_->size();
-            uint8_t *dataPtr = parseBuf_->data();
-            //һϢ20ֽ
-            while (size >= 20)
-            {
-                //ƥϢͷ
-                if (get_value(dataPtr + offset) != head)
-                {
-                    size_t bufSize = parseBuf_->size();
-                    //Ϣͷ
-                    while (offset < bufSize - 3 && get_value(dataPtr + offset) != head)
-                        ++offset;
-                    if (offset == bufSize - 3)
-                    {
-                        //δѵϢͷݣĩβ3ֽ
-                        memcpy(dataPtr, dataPtr + offset, 3);
-                        parseBuf_->resize(3);
-                        // qDebug(u8"ʱûҵһϢͷѶ%dֽ", offset);
-                        break;
-                    }
-                    // qDebug(u8"ҵһϢͷѶ%dֽ", offset);
-                    size = bufSize - offset;
-                    //ʣֽС20޷Ϣ
-                    if (size < 20)
-                        break;
-                }
-                //ϢͷȷȡϢС
-                int msgSize = SwapEndian32(get_value(dataPtr + offset + 4));
-                if (msgSize < 20)
-                {
-                    // emit errorTips(QStringLiteral("ϢС!"));
-
-                    int *ptr = (int *)(dataPtr + offset);
-                    //ظϢ
-                    std::vector<int> replyMsg(5);
-                    replyMsg[0] = SwapEndian32(1234567890);
-                    replyMsg[1] = SwapEndian32(20);
-                    replyMsg[4] = SwapEndian32(-1234567890);
-                    replyMsg[2] = ptr[2];
-                    replyMsg[3] = SwapEndian32(1);  // Bad syntax
-                    client_->write_some(boost::asio::buffer(replyMsg));
-
-                    offset += 4;
-                    size -= 4;
-                    continue;
-                }
-                //Ϣδ
-                if (size < msgSize)
-                {
-                    if (offset > 0)
-                    {
-                        memcpy(dataPtr, dataPtr + offset, size);
-                        parseBuf_->resize(size);
-                        offset = 0;
-                    }
-                    break;
-                }
-                //Ϣβ
-                if (get_value(dataPtr + offset + msgSize - 4) != tail)
-                {
-                    // emit errorTips(QStringLiteral("Ϣβ!"));
-
-                    int *ptr = (int *)(dataPtr + offset);
-                    //ظϢ
-                    std::vector<int> replyMsg(5);
-                    replyMsg[0] = SwapEndian32(1234567890);
-                    replyMsg[1] = SwapEndian32(20);
-                    replyMsg[4] = SwapEndian32(-1234567890);
-                    replyMsg[2] = ptr[2];
-                    replyMsg[3] = SwapEndian32(1);  // Bad syntax
-                    client_->write_some(boost::asio::buffer(replyMsg));
-
-                    offset += 4;
-                    size -= 4;
-                    continue;
-                }
-                //Ϣȷ
-
-                int *ptr = (int *)(dataPtr + offset);
-
-                auto type = SwapEndian32(ptr[3]);
-                auto dlen = SwapEndian32(ptr[4]);
-
-                //ظϢ
-                std::vector<int> replyMsg(5);
-                replyMsg[0] = SwapEndian32(1234567890);
-                replyMsg[1] = SwapEndian32(20);
-                replyMsg[4] = SwapEndian32(-1234567890);
-                replyMsg[2] = ptr[2];
-
-                constexpr auto DATA_OFFSET = 5;
-
-                replyMsg[3] = SwapEndian32(0);
-                client_->write_some(boost::asio::buffer(replyMsg));
-
-                if (xfer_)
-                {
-                    data_ptr data(new std::vector<uint8_t>(dataPtr + offset + DATA_OFFSET * sizeof(int), dataPtr + offset + DATA_OFFSET * sizeof(int) + dlen));
-                    xfer_(type, data);
-                }
-
-                offset += msgSize;
-                size -= msgSize;
-                if (size < 1024 || offset > 2024)
-                {
-                    memcpy(dataPtr, dataPtr + offset, size);
-                    parseBuf_->resize(size);
-                    offset = 0;
-                }
-            }
-        }
-        check_connection();
+        auto &c = *pair.second;
+        result.push_back({ c.id_, c.peer_, c.requests_, c.errors_, c.pending_, c.replied_, c.writes_ });
     }
+    return result;
 }
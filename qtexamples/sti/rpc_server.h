@@ -4,11 +4,23 @@
 
 using data_ptr = std::shared_ptr<std::vector<uint8_t>>;
 using xfer_handler = std::function<void(int type, data_ptr data)>;
+/** ͬ, client ǷĿͻ˱,  response ָظ */
+using xfer_client_handler = std::function<void(int client, int type, data_ptr data)>;
 
+/***************************************************************
+ * @class rpc_server
+ * @brief նͻ˵Ŀ: հӦӵ strand , xfer صڹִ̳߳.
+ * @note  ͬһͻ˵󰴵˳ص, ͬͻ˵Ļصܲ;
+ *        ÿζӦϲһ첽д, ݲȴ.
+ ***************************************************************/
 class rpc_server : public tcp_server
 {
 public:
-    rpc_server();
+    /**
+     * @param threads շ߳, 0 ʾ CPU ȡ 1~4
+     * @param workers ִ xfer ص߳, 0 ͬ
+     */
+    rpc_server(size_t threads = 0, size_t workers = 0);
     ~rpc_server();
 
     /**
@@ -19,24 +31,27 @@ public:
     using tcp_server::start;
     virtual void stop() override;
 
-    void bind_xfer_handler(const xfer_handler &handler)
-    {
-        xfer_ = handler;
-    }
+    /** ֻ start ֮ǰ */
+    void bind_xfer_handler(const xfer_handler &handler);
+    void bind_xfer_handler(const xfer_client_handler &handler);
+    /**  xfer صʱظĿͻ, ظпͻ */
     void response(int type, const data_ptr data);
+    /** ظָͻ, ̵߳ */
+    void response(int client, int type, const data_ptr data);
 
-private:
-    void check_connection();
-    /**
-     * @brief ȡݴ
-     * @param[in] ec 
-     * @param[in] bytes_transferred յֽ
-     */
-    void read_handler(const boost::system::error_code &ec, size_t bytes_transferred);
+    struct client_status
+    {
+        int id;
+        std::string peer;  // ͻ˵ַ
+        uint64_t requests; // յ
+        uint64_t errors;   // ʽ
+        uint64_t pending;  // յ, xfer صûִ
+        uint64_t replied;  // ѷ͵Ӧֽ
+        uint64_t writes;   // 첽д,  requests ȼӦĺϲ̶
+    };
+    std::vector<client_status> get_client_status() const;
 
 private:
-    sock_ptr client_{ nullptr };
-    data_ptr readBuf_;
-    data_ptr parseBuf_;
-    xfer_handler xfer_;
+    struct rpc_server_impl;
+    std::shared_ptr<rpc_server_impl> impl_;
 };
@@ -0,0 +1,562 @@
+#include "shm_ring.h"
+#include <cstring>
+#include <iostream>
+#include <thread>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <climits>
+    #include <fcntl.h>
+    #include <linux/futex.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#endif
+
+namespace cortex
+{
+    static constexpr uint32_t SHM_RING_MAGIC = 0x53544952;  // "STIR"
+    static constexpr uint32_t SHM_RING_VERSION = 1;
+    static constexpr uint32_t RECORD_PAD = 1;  // fills the end of the ring when a message does not fit before the wrap
+    static constexpr uint64_t RECORD_ALIGN = 16;
+
+    // every message is preceded by a record header, records are RECORD_ALIGN aligned and never wrap
+    struct shm_record
+    {
+        uint32_t len;    // payload bytes
+        uint32_t flags;
+        uint64_t seq;    // message sequence number, gaps are messages a reader missed
+    };
+    static_assert(sizeof(shm_record) == RECORD_ALIGN);
+
+    static uint64_t record_bytes(uint64_t len)
+    {
+        return (sizeof(shm_record) + len + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+    }
+
+    struct alignas(64) shm_reader_slot
+    {
+        std::atomic<uint32_t> pid;       // 0 when free
+        std::atomic<uint32_t> sleeping;  // the reader is about to block or blocked on its wake
+        std::atomic<uint64_t> cursor;    // published for the writer's status only
+        std::atomic<uint64_t> messages;
+        std::atomic<uint64_t> lost;
+    };
+
+    // the segment: this header followed by the data ring, positions grow monotonically and are masked into it
+    struct shm_ring_layout
+    {
+        std::atomic<uint32_t> magic;  // stored last by the writer, readers refuse a ring still being set up
+        uint32_t version;
+        uint64_t capacity;
+        uint32_t writer_pid;
+        std::atomic<uint32_t> closed;
+
+        alignas(64) std::atomic<uint64_t> write_pos;  // end of the last published record
+        std::atomic<uint64_t> tail;                    // start of the oldest record not yet being overwritten
+
+        alignas(64) std::atomic<uint32_t> signal;  // futex word, bumped on every publish
+        std::atomic<uint32_t> sleepers;            // readers blocked or about to block
+        std::atomic<uint32_t> readers;             // attached readers
+
+        shm_reader_slot slots[SHM_RING_READERS];
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring positions are shared between processes");
+    static_assert(sizeof(shm_ring_layout) % 64 == 0);
+
+    static inline void cpu_pause()
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    static uint32_t current_pid()
+    {
+#ifdef _WIN32
+        return GetCurrentProcessId();
+#else
+        return (uint32_t)getpid();
+#endif
+    }
+
+    static bool process_alive(uint32_t pid)
+    {
+#ifdef _WIN32
+        auto process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+        if (!process) return GetLastError() == ERROR_ACCESS_DENIED;
+        auto alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+        CloseHandle(process);
+        return alive;
+#else
+        return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+#endif
+    }
+
+#ifdef _WIN32
+    static std::string mapping_name(const std::string &name)
+    {
+        return "Local\\sti_ring_" + name;
+    }
+
+    static std::string event_name(const std::string &name, int slot, uint32_t pid)
+    {
+        return "Local\\sti_ring_" + name + "_" + std::to_string(slot) + "_" + std::to_string(pid);
+    }
+#else
+    static std::string mapping_name(const std::string &name)
+    {
+        return "/sti_ring_" + name;
+    }
+
+    static long futex(std::atomic<uint32_t> *word, int op, uint32_t value, const timespec *timeout)
+    {
+        // shared (not FUTEX_PRIVATE) operations, the word lives in a mapping of several processes
+        return syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), op, value, timeout, nullptr, 0);
+    }
+
+    // an existing segment whose writer is still running and has not closed it
+    static bool segment_in_use(const std::string &path)
+    {
+        int fd = shm_open(path.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        struct stat st;
+        void *view = fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(shm_ring_layout) ?
+            mmap(nullptr, sizeof(shm_ring_layout), PROT_READ, MAP_SHARED, fd, 0) :
+            MAP_FAILED;
+        ::close(fd);
+        if (view == MAP_FAILED) return false;
+        auto ring = static_cast<const shm_ring_layout *>(view);
+        auto in_use = ring->magic.load(std::memory_order_acquire) == SHM_RING_MAGIC && !ring->closed.load() && process_alive(ring->writer_pid);
+        munmap(view, sizeof(shm_ring_layout));
+        return in_use;
+    }
+#endif
+
+    // map an existing segment, or create one of bytes if bytes is not 0
+    static shm_ring_layout *map_segment(const std::string &name, size_t bytes, size_t &mapped, [[maybe_unused]] void *&mapping)
+    {
+#ifdef _WIN32
+        HANDLE handle;
+        if (bytes)
+        {
+            handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(uint64_t(bytes) >> 32), DWORD(bytes), mapping_name(name).c_str());
+            if (handle && GetLastError() == ERROR_ALREADY_EXISTS)
+            {
+                // readers of a previous writer still hold it, they let go once they notice it closed
+                CloseHandle(handle);
+                std::cerr << "shm ring " << name << " is still in use" << std::endl;
+                return nullptr;
+            }
+        }
+        else
+        {
+            handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mapping_name(name).c_str());
+        }
+        if (!handle) return nullptr;
+        auto view = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+        MEMORY_BASIC_INFORMATION info{};
+        if (!view || !VirtualQuery(view, &info, sizeof(info)))
+        {
+            if (view) UnmapViewOfFile(view);
+            CloseHandle(handle);
+            return nullptr;
+        }
+        mapped = bytes ? bytes : info.RegionSize;
+        mapping = handle;
+        return static_cast<shm_ring_layout *>(view);
+#else
+        auto path = mapping_name(name);
+        int fd;
+        if (bytes)
+        {
+            if (segment_in_use(path))
+            {
+                std::cerr << "shm ring " << name << " is still in use" << std::endl;
+                return nullptr;
+            }
+            // a segment left behind by a writer that crashed, its readers keep their own mapping and notice it is gone
+            shm_unlink(path.c_str());
+            fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+            if (fd >= 0 && ftruncate(fd, (off_t)bytes) != 0)
+            {
+                ::close(fd);
+                shm_unlink(path.c_str());
+                fd = -1;
+            }
+        }
+        else
+        {
+            fd = shm_open(path.c_str(), O_RDWR, 0);
+            struct stat st;
+            if (fd >= 0 && fstat(fd, &st) == 0)
+            {
+                bytes = (size_t)st.st_size;
+            }
+        }
+        if (fd < 0) return nullptr;
+        void *view = bytes >= sizeof(shm_ring_layout) ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (view == MAP_FAILED) return nullptr;
+        mapped = bytes;
+        return static_cast<shm_ring_layout *>(view);
+#endif
+    }
+
+    static void unmap_segment(shm_ring_layout *ring, [[maybe_unused]] size_t mapped, [[maybe_unused]] void *&mapping)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(ring);
+        CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        munmap(ring, mapped);
+#endif
+    }
+
+    shm_ring_writer::~shm_ring_writer()
+    {
+        close();
+    }
+
+    bool shm_ring_writer::create(const std::string &name, size_t capacity)
+    {
+        close();
+        uint64_t cap = 4096;
+        while (cap < capacity)
+        {
+            cap <<= 1;
+        }
+        auto ring = map_segment(name, sizeof(shm_ring_layout) + cap, mapped_, mapping_);
+        if (!ring)
+        {
+            std::cerr << "create shm ring " << name << " failed" << std::endl;
+            return false;
+        }
+        // a fresh mapping is zero filled, which is a valid initial state for all the atomics
+        ring->version = SHM_RING_VERSION;
+        ring->capacity = cap;
+        ring->writer_pid = current_pid();
+        ring->magic.store(SHM_RING_MAGIC, std::memory_order_release);
+
+        name_ = name;
+        ring_ = ring;
+        data_ = reinterpret_cast<uint8_t *>(ring + 1);
+        mask_ = cap - 1;
+        pos_ = tail_ = seq_ = 0;
+        return true;
+    }
+
+    void shm_ring_writer::close()
+    {
+        if (!ring_) return;
+        ring_->closed.store(1);
+        ring_->signal.fetch_add(1);
+        wake();
+#ifdef _WIN32
+        for (auto &event : events_)
+        {
+            if (event) CloseHandle(event);
+            event = nullptr;
+        }
+#else
+        shm_unlink(mapping_name(name_).c_str());
+#endif
+        unmap_segment(ring_, mapped_, mapping_);
+        ring_ = nullptr;
+        data_ = nullptr;
+    }
+
+    void shm_ring_writer::reserve(uint64_t pos, uint64_t bytes)
+    {
+        if (pos + bytes - tail_ <= mask_ + 1) return;
+        while (pos + bytes - tail_ > mask_ + 1)
+        {
+            shm_record record;
+            memcpy(&record, data_ + (tail_ & mask_), sizeof(record));
+            tail_ += record_bytes(record.len);
+        }
+        // readers copy first and check the tail afterwards: the new tail must be visible before the overwrite is
+        ring_->tail.store(tail_, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    bool shm_ring_writer::write(std::initializer_list<std::span<const uint8_t>> parts)
+    {
+        if (!ring_) return false;
+        uint64_t len = 0;
+        for (auto &part : parts)
+        {
+            len += part.size();
+        }
+        if (record_bytes(len) > (mask_ + 1) / 4) return false;
+        // readers attach at the newest message, nothing written while nobody is attached would ever be read
+        if (ring_->readers.load(std::memory_order_relaxed) == 0)
+        {
+            skipped_++;
+            return true;
+        }
+
+        auto bytes = record_bytes(len);
+        auto offset = pos_ & mask_;
+        if (offset + bytes > mask_ + 1)
+        {
+            auto pad = mask_ + 1 - offset;
+            reserve(pos_, pad);
+            shm_record record{ uint32_t(pad - sizeof(shm_record)), RECORD_PAD, 0 };
+            memcpy(data_ + offset, &record, sizeof(record));
+            pos_ += pad;
+            offset = 0;
+        }
+        reserve(pos_, bytes);
+        shm_record record{ uint32_t(len), 0, seq_++ };
+        auto ptr = data_ + offset;
+        memcpy(ptr, &record, sizeof(record));
+        ptr += sizeof(record);
+        for (auto &part : parts)
+        {
+            memcpy(ptr, part.data(), part.size());
+            ptr += part.size();
+        }
+        pos_ += bytes;
+        messages_++;
+        bytes_ += len;
+
+        // pairs with the reader announcing itself in sleepers before it looks at write_pos one last time
+        ring_->write_pos.store(pos_);
+        ring_->signal.fetch_add(1);
+        if (ring_->sleepers.load() != 0) wake();
+        return true;
+    }
+
+    void shm_ring_writer::wake()
+    {
+        wakes_++;
+#ifdef _WIN32
+        for (int i = 0; i < SHM_RING_READERS; ++i)
+        {
+            auto &slot = ring_->slots[i];
+            auto pid = slot.pid.load();
+            if (!pid || !slot.sleeping.exchange(0)) continue;
+            if (event_pids_[i] != pid)
+            {
+                if (events_[i]) CloseHandle(events_[i]);
+                events_[i] = OpenEventA(EVENT_MODIFY_STATE, FALSE, event_name(name_, i, pid).c_str());
+                event_pids_[i] = pid;
+            }
+            if (events_[i]) SetEvent(events_[i]);
+        }
+#else
+        futex(&ring_->signal, FUTEX_WAKE, INT_MAX, nullptr);
+#endif
+    }
+
+    shm_ring_writer::status shm_ring_writer::get_status() const
+    {
+        status result{ messages_, bytes_, skipped_, wakes_, {} };
+        if (!ring_) return result;
+        for (int i = 0; i < SHM_RING_READERS; ++i)
+        {
+            auto &slot = ring_->slots[i];
+            if (auto pid = slot.pid.load(std::memory_order_relaxed))
+            {
+                auto cursor = slot.cursor.load(std::memory_order_relaxed);
+                result.readers.push_back({ i, pid, pos_ > cursor ? pos_ - cursor : 0, slot.messages.load(std::memory_order_relaxed),
+                    slot.lost.load(std::memory_order_relaxed) });
+            }
+        }
+        return result;
+    }
+
+    shm_ring_reader::~shm_ring_reader()
+    {
+        close();
+    }
+
+    bool shm_ring_reader::open(const std::string &name)
+    {
+        close();
+        auto ring = map_segment(name, 0, mapped_, mapping_);
+        if (!ring) return false;
+        if (ring->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC || ring->version != SHM_RING_VERSION ||
+            mapped_ < sizeof(shm_ring_layout) + ring->capacity || ring->closed.load())
+        {
+            unmap_segment(ring, mapped_, mapping_);
+            return false;
+        }
+
+        // take a free slot, or one whose reader died without letting go
+        auto pid = current_pid();
+        int slot = -1;
+        for (int i = 0; i < SHM_RING_READERS && slot < 0; ++i)
+        {
+            uint32_t expected = 0;
+            if (ring->slots[i].pid.compare_exchange_strong(expected, pid))
+            {
+                ring->readers.fetch_add(1);
+                slot = i;
+            }
+        }
+        for (int i = 0; i < SHM_RING_READERS && slot < 0; ++i)
+        {
+            auto expected = ring->slots[i].pid.load();
+            if (!process_alive(expected) && ring->slots[i].pid.compare_exchange_strong(expected, pid)) slot = i;
+        }
+        if (slot < 0)
+        {
+            std::cerr << "shm ring " << name << ": all " << SHM_RING_READERS << " reader slots are taken" << std::endl;
+            unmap_segment(ring, mapped_, mapping_);
+            return false;
+        }
+#ifdef _WIN32
+        event_ = CreateEventA(nullptr, FALSE, FALSE, event_name(name, slot, pid).c_str());
+#endif
+
+        ring_ = ring;
+        data_ = reinterpret_cast<uint8_t *>(ring + 1);
+        mask_ = ring->capacity - 1;
+        slot_ = slot;
+        auto &s = ring->slots[slot];
+        s.sleeping.store(0);
+        s.messages.store(0);
+        s.lost.store(0);
+        // the readers count above makes the writer publish from now on, start at what it published last
+        cursor_ = ring->write_pos.load(std::memory_order_acquire);
+        s.cursor.store(cursor_);
+        started_ = false;
+        return true;
+    }
+
+    void shm_ring_reader::close()
+    {
+        if (!ring_) return;
+        ring_->slots[slot_].pid.store(0);
+        ring_->readers.fetch_sub(1);
+#ifdef _WIN32
+        if (event_) CloseHandle(event_);
+        event_ = nullptr;
+#endif
+        unmap_segment(ring_, mapped_, mapping_);
+        ring_ = nullptr;
+        data_ = nullptr;
+        slot_ = -1;
+    }
+
+    bool shm_ring_reader::writer_alive() const
+    {
+        return !ring_->closed.load() && process_alive(ring_->writer_pid);
+    }
+
+    std::span<const uint8_t> shm_ring_reader::read(std::chrono::milliseconds timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (ring_)
+        {
+            auto &slot = ring_->slots[slot_];
+            if (cursor_ == ring_->write_pos.load(std::memory_order_acquire))
+            {
+                if (!wait(deadline)) return {};
+                continue;
+            }
+            auto tail = ring_->tail.load(std::memory_order_acquire);
+            if (cursor_ < tail)
+            {
+                // lapped by the writer, the sequence numbers tell how many messages went by
+                overruns_++;
+                cursor_ = tail;
+                continue;
+            }
+
+            shm_record record;
+            auto ptr = data_ + (cursor_ & mask_);
+            memcpy(&record, ptr, sizeof(record));
+            auto bytes = record_bytes(record.len);
+            auto valid = bytes <= mask_ + 1 - (cursor_ & mask_);
+            if (valid && !(record.flags & RECORD_PAD))
+            {
+                if (buffer_.size() < record.len) buffer_.resize(record.len);
+                memcpy(buffer_.data(), ptr + sizeof(record), record.len);
+            }
+            // the copy is only good if the writer did not start reclaiming it meanwhile
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (ring_->tail.load(std::memory_order_relaxed) > cursor_)
+            {
+                continue;
+            }
+            if (!valid)
+            {
+                // cannot happen with an intact ring, start over at the newest message rather than spin
+                overruns_++;
+                cursor_ = ring_->write_pos.load(std::memory_order_acquire);
+                continue;
+            }
+            cursor_ += bytes;
+            slot.cursor.store(cursor_, std::memory_order_relaxed);
+            if (record.flags & RECORD_PAD) continue;
+
+            if (started_ && record.seq != next_seq_)
+            {
+                lost_ += record.seq - next_seq_;
+                slot.lost.store(lost_, std::memory_order_relaxed);
+            }
+            started_ = true;
+            next_seq_ = record.seq + 1;
+            messages_++;
+            bytes_ += record.len;
+            slot.messages.store(messages_, std::memory_order_relaxed);
+            return { buffer_.data(), record.len };
+        }
+        return {};
+    }
+
+    bool shm_ring_reader::wait(std::chrono::steady_clock::time_point deadline)
+    {
+        // a short spin catches a writer that is mid burst without any syscall
+        for (int i = 0; i < 256; ++i)
+        {
+            if (cursor_ != ring_->write_pos.load(std::memory_order_acquire)) return true;
+            cpu_pause();
+        }
+        if (!writer_alive())
+        {
+            close();
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) return false;
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+
+        ring_->sleepers.fetch_add(1);
+        auto signal = ring_->signal.load();
+#ifdef _WIN32
+        auto &slot = ring_->slots[slot_];
+        slot.sleeping.store(1);
+        if (cursor_ == ring_->write_pos.load() && !ring_->closed.load())
+        {
+            WaitForSingleObject(event_, DWORD((remaining + 999) / 1000));
+        }
+        slot.sleeping.store(0);
+#else
+        if (cursor_ == ring_->write_pos.load() && !ring_->closed.load())
+        {
+            timespec ts{ time_t(remaining / 1000000), long(remaining % 1000000 * 1000) };
+            futex(&ring_->signal, FUTEX_WAIT, signal, &ts);
+        }
+#endif
+        ring_->sleepers.fetch_sub(1);
+        return true;
+    }
+
+    shm_ring_reader::status shm_ring_reader::get_status() const
+    {
+        return { messages_, bytes_, lost_, overruns_ };
+    }
+}  // namespace cortex
@@ -0,0 +1,144 @@
+// Description: Provide a shared memory ring carrying STI messages from one writer to many readers on the same host
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <vector>
+
+/* One writer process appends whole messages to a named segment, up to SHM_RING_READERS reader processes follow it
+ * with their own cursors. The writer never waits for readers: a reader that falls a full ring behind jumps to the
+ * oldest message still intact and counts what it missed from the record sequence numbers, like a slow UDP receiver.
+ * A reader copies each message out of the ring and checks afterwards that the writer did not reclaim it meanwhile
+ * (seqlock style), so a torn message is never handed out.
+ * An idle reader sleeps on a futex in the segment (Linux) or on its own named event (Windows); the writer makes the
+ * wake call only when some reader is actually asleep, and skips the copy entirely while no reader is attached.
+ */
+namespace cortex
+{
+    constexpr int SHM_RING_READERS = 16;
+
+    struct shm_ring_layout;
+
+    class shm_ring_writer
+    {
+    public:
+        shm_ring_writer() = default;
+        ~shm_ring_writer();
+        shm_ring_writer(const shm_ring_writer &) = delete;
+        shm_ring_writer &operator=(const shm_ring_writer &) = delete;
+
+        /** create the named segment, capacity is rounded up to a power of two; a segment of the same name left by a dead writer is replaced, one whose writer still runs is not */
+        bool create(const std::string &name, size_t capacity);
+        /** mark the ring closed (attached readers see it and let go) and release the segment */
+        void close();
+        bool is_open() const
+        {
+            return ring_ != nullptr;
+        }
+        const std::string &name() const
+        {
+            return name_;
+        }
+
+        /** append one message gathered from parts, false if it is larger than a quarter of the ring */
+        bool write(std::initializer_list<std::span<const uint8_t>> parts);
+
+        struct reader_status
+        {
+            int slot;
+            uint32_t pid;
+            uint64_t lag_bytes;  // written but not yet read by this reader
+            uint64_t messages;   // messages read
+            uint64_t lost;       // messages overwritten before this reader got to them
+        };
+        struct status
+        {
+            uint64_t messages;  // messages written
+            uint64_t bytes;
+            uint64_t skipped;   // messages dropped because no reader was attached
+            uint64_t wakes;     // wake calls made for sleeping readers
+            std::vector<reader_status> readers;
+        };
+        status get_status() const;
+
+    private:
+        // make [pos, pos + bytes) writable, moving the tail past the records it overlaps
+        void reserve(uint64_t pos, uint64_t bytes);
+        void wake();
+
+        std::string name_;
+        shm_ring_layout *ring_ = nullptr;
+        uint8_t *data_ = nullptr;
+        size_t mapped_ = 0;
+        uint64_t mask_ = 0;
+        uint64_t pos_ = 0;   // private copies of write_pos / tail, only this writer changes them
+        uint64_t tail_ = 0;
+        uint64_t seq_ = 0;
+        uint64_t messages_ = 0;
+        uint64_t bytes_ = 0;
+        uint64_t skipped_ = 0;
+        uint64_t wakes_ = 0;
+        void *mapping_ = nullptr;                      // Windows file mapping handle
+        void *events_[SHM_RING_READERS] = {};          // Windows per reader wake events, opened on first use
+        uint32_t event_pids_[SHM_RING_READERS] = {};  // reader the cached event belongs to
+    };
+
+    class shm_ring_reader
+    {
+    public:
+        shm_ring_reader() = default;
+        ~shm_ring_reader();
+        shm_ring_reader(const shm_ring_reader &) = delete;
+        shm_ring_reader &operator=(const shm_ring_reader &) = delete;
+
+        /** attach to a segment created by shm_ring_writer, reading starts at the newest message; false if there is no such ring or all reader slots are taken */
+        bool open(const std::string &name);
+        void close();
+        /** false after close, or once read found that the writer closed the ring or went away */
+        bool is_open() const
+        {
+            return ring_ != nullptr;
+        }
+
+        /**
+         * wait up to timeout for the next message, copied out of the ring into a buffer reused by every call
+         * returns an empty span on timeout or when the ring went away (check is_open)
+         */
+        std::span<const uint8_t> read(std::chrono::milliseconds timeout);
+
+        struct status
+        {
+            uint64_t messages;   // messages read
+            uint64_t bytes;
+            uint64_t lost;       // messages overwritten before they were read
+            uint64_t overruns;   // times the writer lapped this reader
+        };
+        /** safe to call from any thread, counters survive close/open */
+        status get_status() const;
+
+    private:
+        bool wait(std::chrono::steady_clock::time_point deadline);
+        bool writer_alive() const;
+
+        shm_ring_layout *ring_ = nullptr;
+        uint8_t *data_ = nullptr;
+        size_t mapped_ = 0;
+        uint64_t mask_ = 0;
+        int slot_ = -1;
+        uint64_t cursor_ = 0;
+        uint64_t next_seq_ = 0;
+        bool started_ = false;  // next_seq_ is valid
+        std::vector<uint8_t> buffer_;
+        std::atomic<uint64_t> messages_{ 0 };
+        std::atomic<uint64_t> bytes_{ 0 };
+        std::atomic<uint64_t> lost_{ 0 };
+        std::atomic<uint64_t> overruns_{ 0 };
+        void *mapping_ = nullptr;  // Windows file mapping handle
+        void *event_ = nullptr;    // Windows wake event of this reader's slot
+    };
+}  // namespace cortex
@@ -0,0 +1,161 @@
+// Description: Cortex STI message framing shared by the parser and the readers
+
+#pragma once
+
+#include <algorithm>
+#include <boost/endian/conversion.hpp>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace cortex
+{
+    constexpr uint32_t STI_HEAD = 1234567890;
+    constexpr uint32_t STI_TAIL = (uint32_t)-1234567890;
+    constexpr size_t STI_HEADER_BYTES = 8;  // sync word + message length
+    constexpr size_t STI_MIN_MSG_BYTES = STI_HEADER_BYTES + 4;
+    constexpr size_t STI_MAX_MSG_BYTES = 16 << 20;
+
+    /** offset of the first complete sync word in [ptr, ptr + len), len if none */
+    inline size_t find_sti_head(const uint8_t *ptr, size_t len)
+    {
+        if (len < 4) return len;
+        // memchr is vectorised by the C runtime, the 32-bit compare only runs on candidate bytes
+        auto end = ptr + len - 3;
+        for (auto p = ptr; (p = (const uint8_t *)memchr(p, STI_HEAD >> 24, end - p)) != nullptr; ++p)
+        {
+            if (boost::endian::load_big_u32(p) == STI_HEAD) return p - ptr;
+        }
+        return len;
+    }
+
+    /** a message length is plausible */
+    inline bool is_sti_length(size_t len)
+    {
+        return len >= STI_MIN_MSG_BYTES && len <= STI_MAX_MSG_BYTES;
+    }
+
+    /**
+     * hand every complete message in [ptr, ptr + len) to on_msg(const uint8_t *msg, size_t len)
+     * @param errors counts framing errors (bad length or tail)
+     * @return bytes that can be discarded, the rest is a partial message or a possible partial sync word
+     */
+    template <class F, class Counter>
+    size_t parse_sti_frames(const uint8_t *ptr, size_t len, F &&on_msg, Counter &errors)
+    {
+        size_t pos = 0;
+        size_t parsed = 0;  // end of the last message, nothing before it can start a sync word
+        while (true)
+        {
+            pos += find_sti_head(ptr + pos, len - pos);
+            if (pos == len) return std::max(parsed, len > 3 ? len - 3 : 0);
+            if (len - pos < STI_HEADER_BYTES) return pos;
+
+            auto msg_len = (size_t)boost::endian::load_big_u32(ptr + pos + 4);
+            if (!is_sti_length(msg_len))
+            {
+                errors++;
+                pos++;
+                continue;
+            }
+            if (len - pos < msg_len) return pos;
+            if (boost::endian::load_big_u32(ptr + pos + msg_len - 4) != STI_TAIL)
+            {
+                errors++;
+                pos++;
+                continue;
+            }
+            on_msg(ptr + pos, msg_len);
+            pos += msg_len;
+            parsed = pos;
+        }
+    }
+
+    /**
+     * parses a byte stream held in a lockfree_spsc_queue<uint8_t> in place, without copying it out.
+     * Only the one message that wraps around the end of the ring is stitched in a side buffer.
+     * Keeps the per-stream state, so one consumer thread can drive several streams.
+     */
+    class sti_stream_framer
+    {
+    public:
+        explicit sti_stream_framer(size_t stitch_bytes = 64 * 1024)
+            : buf_(stitch_bytes)
+        {
+        }
+
+        /** bytes the ring has to hold before step() can make progress */
+        size_t need() const
+        {
+            return pending_ + 1;
+        }
+
+        /** bytes taken from the ring that are no longer waiting for more data */
+        uint64_t consumed() const
+        {
+            return consumed_ - carry_;
+        }
+
+        /**
+         * one parse step on what the ring holds, messages go to on_msg(const uint8_t *msg, size_t len)
+         * @return false when the ring does not hold need() bytes yet
+         */
+        template <class Ring, class F, class Counter>
+        bool step(Ring &ring, F &&on_msg, Counter &errors)
+        {
+            if (ring.read_available() < std::min(need(), ring.capacity())) return false;
+            auto span = ring.read_span(0, false);
+            if (carry_ == 0 && span.size() > pending_)
+            {
+                auto used = parse_sti_frames(span.data(), span.size(), on_msg, errors);
+                consume(ring, used);
+                pending_ = span.size() - used;
+                return true;
+            }
+            if (carry_ == 0)
+            {
+                // the partial message reaches the end of the ring (or fills all of it), move it out to stitch
+                carry_ = std::min(span.size(), pending_);
+                if (buf_.size() < carry_) buf_.resize(carry_);
+                memcpy(buf_.data(), span.data(), carry_);
+                consume(ring, carry_);
+                pending_ = 0;
+                return true;
+            }
+
+            // only complete this one message, then go back to parsing in place
+            size_t want = STI_HEADER_BYTES;
+            if (carry_ >= STI_HEADER_BYTES) want = boost::endian::load_big_u32(buf_.data() + 4);
+            auto n = std::min(span.size(), want > carry_ ? want - carry_ : 1);
+            if (buf_.size() < carry_ + n) buf_.resize(std::max(buf_.size() * 2, carry_ + n));
+            memcpy(buf_.data() + carry_, span.data(), n);
+            consume(ring, n);
+            carry_ += n;
+
+            auto used = parse_sti_frames(buf_.data(), carry_, on_msg, errors);
+            memmove(buf_.data(), buf_.data() + used, carry_ - used);
+            carry_ -= used;
+            return true;
+        }
+
+        void reset()
+        {
+            pending_ = carry_ = 0;
+            consumed_ = 0;
+        }
+
+    private:
+        template <class Ring>
+        void consume(Ring &ring, size_t n)
+        {
+            ring.consume(n);
+            consumed_ += n;
+        }
+
+    private:
+        std::vector<uint8_t> buf_;
+        size_t pending_ = 0;  // bytes at the read position already scanned, not a complete message yet
+        size_t carry_ = 0;    // bytes of the wrapped message in buf_
+        uint64_t consumed_ = 0;
+    };
+}  // namespace cortex
@@ -1,10 +1,18 @@
 #include "tcp_client.h"
 #include <atomic>
+#include <cstring>
 #include <iostream>
 #ifdef _MSC_VER
     #define _WIN32_WINNT 0x0501
 #endif
 #include <boost/asio.hpp>
+#ifdef _WIN32
+    #include <mstcpip.h>
+#else
+    #include <linux/sock_diag.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+#endif
 
 using boost::asio::ip::tcp;
 
@@ -17,9 +25,47 @@ struct sync_tcp_client::sync_tcp_client_imp_t
         socket_->open(boost::asio::ip::tcp::v4());
     }
 
+    //ǰѡ: ջҪǰȷЭ̴
+    void apply_options()
+    {
+        boost::system::error_code ec;
+        if (opts_.recv_buffer > 0)
+        {
+            socket_->set_option(boost::asio::socket_base::receive_buffer_size(opts_.recv_buffer), ec);
+            if (ec) std::cerr << "SO_RCVBUF: " << ec.message() << std::endl;
+        }
+        if (opts_.no_delay)
+        {
+            socket_->set_option(tcp::no_delay(true), ec);
+            if (ec) std::cerr << "TCP_NODELAY: " << ec.message() << std::endl;
+        }
+#ifdef __linux__
+        if (opts_.busy_poll_us > 0)
+        {
+            int value = opts_.busy_poll_us;
+            if (setsockopt(socket_->native_handle(), SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) != 0)
+                std::cerr << "SO_BUSY_POLL: " << strerror(errno) << std::endl;
+        }
+#endif
+    }
+
+    //ںӳȷģʽ»Զָ, ÿζ´
+    void quick_ack()
+    {
+#ifdef __linux__
+        if (opts_.quick_ack)
+        {
+            int one = 1;
+            setsockopt(socket_->native_handle(), IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+        }
+#endif
+    }
+
     std::atomic_bool is_connected_;        // ӱ־
     boost::asio::io_service io_service_;   // asio
     std::shared_ptr<tcp::socket> socket_;  // socket
+    options opts_;                         // ʱӦ
+    std::atomic_uint64_t received_ = 0;    // ۼƽֽ
 };
 
 sync_tcp_client::sync_tcp_client()
@@ -57,6 +103,51 @@ bool sync_tcp_client::bind(const std::string &ip, uint16_t port)
     return true;
 }
 
+void sync_tcp_client::set_options(const options &opts)
+{
+    imp_->opts_ = opts;
+}
+
+sync_tcp_client::options sync_tcp_client::get_options() const
+{
+    return imp_->opts_;
+}
+
+sync_tcp_client::socket_status sync_tcp_client::get_socket_status() const
+{
+    socket_status status{ imp_->received_, 0, 0, 0, 0, 0 };
+    if (!imp_->socket_ || !imp_->socket_->is_open())
+        return status;
+    boost::system::error_code ec;
+    status.queued = imp_->socket_->available(ec);
+    boost::asio::socket_base::receive_buffer_size size;
+    imp_->socket_->get_option(size, ec);
+    if (!ec)
+        status.recv_buffer = size.value();
+    auto fd = imp_->socket_->native_handle();
+#ifdef _WIN32
+    #ifdef SIO_TCP_INFO
+    DWORD version = 0, bytes = 0;
+    TCP_INFO_v0 info{};
+    if (WSAIoctl(fd, SIO_TCP_INFO, &version, sizeof(version), &info, sizeof(info), &bytes, nullptr, nullptr) == 0)
+        status.rtt_us = info.RttUs;
+    #endif
+#else
+    uint32_t meminfo[SK_MEMINFO_VARS] = {};
+    socklen_t len = sizeof(meminfo);
+    if (getsockopt(fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0 && len > SK_MEMINFO_DROPS * sizeof(uint32_t))
+        status.drops = meminfo[SK_MEMINFO_DROPS];
+    tcp_info info{};
+    len = sizeof(info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0)
+    {
+        status.rtt_us = info.tcpi_rtt;
+        status.rcv_space = info.tcpi_rcv_space;
+    }
+#endif
+    return status;
+}
+
 bool sync_tcp_client::is_connected()
 {
     return imp_->is_connected_;
@@ -71,6 +162,9 @@ bool sync_tcp_client::connect(const std::string &ip, uint16_t port)
             boost::system::error_code ec;
             // endpointװipͶ˿
             tcp::endpoint ep(boost::asio::ip::address::from_string(ip), port);
+            if (!imp_->socket_->is_open())
+                imp_->socket_->open(ep.protocol());
+            imp_->apply_options();
             imp_->socket_->connect(ep, ec);
             if (ec)
             {
@@ -149,18 +243,25 @@ int sync_tcp_client::send(const std::vector<uint8_t> &buf)
 }
 
 int sync_tcp_client::receive_some(std::vector<uint8_t> &buf)
+{
+    return receive_some(buf.data(), buf.size());
+}
+
+int sync_tcp_client::receive_some(uint8_t *data, size_t len)
 {
     if (imp_->is_connected_)
     {
         try
         {
             boost::system::error_code ec;
-            size_t bytes_transferred = imp_->socket_->read_some(boost::asio::buffer(buf), ec);
+            size_t bytes_transferred = imp_->socket_->read_some(boost::asio::buffer(data, len), ec);
             if (ec)
             {
                 std::cerr << ec.message() << std::endl;
                 return 0;
             }
+            imp_->quick_ack();
+            imp_->received_ += bytes_transferred;
             return bytes_transferred;
         }
         catch (std::exception &e)
@@ -184,6 +285,7 @@ int sync_tcp_client::receive(std::vector<uint8_t> &buf, size_t size)
                 std::cerr << ec.message() << std::endl;
                 return 0;
             }
+            imp_->received_ += bytes_transferred;
             return bytes_transferred;
         }
         catch (std::exception &e)
@@ -17,6 +17,29 @@ public:
     sync_tcp_client();
     ~sync_tcp_client();
 
+    /** ն˵׽ѡ,  connect ֮ǰ, ÿʱЧ */
+    struct options
+    {
+        int recv_buffer = 0;    // SO_RCVBUF ֽ, 0 ʹϵͳĬ; ҪǰòЭ̴󴰿
+        bool no_delay = false;  // TCP_NODELAY, 󲻵ȴϲ
+        bool quick_ack = false; // TCP_QUICKACK, ÿζȷ,  Linux, ÿνնһϵͳ
+        int busy_poll_us = 0;   // SO_BUSY_POLL, ǰѯе΢,  Linux, ϵͳҪ CAP_NET_ADMIN
+    };
+    void set_options(const options &opts);
+    options get_options() const;
+
+    /** ں˽նе״̬, ֵ֧Ϊ 0 */
+    struct socket_status
+    {
+        uint64_t received;     // ۼƽյֽ
+        size_t queued;         // ں˽նлûȡֽ(FIONREAD)
+        int recv_buffer;       // ʵЧ SO_RCVBUF
+        uint32_t drops;        // ׽ֽնں˶İ(Linux SO_MEMINFO)
+        uint32_t rtt_us;       // ƽʱ, ȡ TCP_INFO
+        uint32_t rcv_space;    // մڵԶֵ, ȡ TCP_INFO,  Linux
+    };
+    socket_status get_socket_status() const;
+
     /** 󶨿ͻʹõipͶ˿ں.
      * @param ip	  ͻ
      * @param port ͻʹö˿
@@ -52,6 +75,8 @@ public:
      * @return ճɹյֽʧܷ0
      */
     int receive_some(std::vector<uint8_t> &buf);
+    /** ͬ, ֱӶ÷Ļ(λĿж) */
+    int receive_some(uint8_t *data, size_t len);
 
     /** Ϣ.
      * @param buf  ϢĻ
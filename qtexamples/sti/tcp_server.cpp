@@ -3,16 +3,19 @@
 
 struct tcp_server::tcp_server_impl
 {
-    tcp_server_impl()
+    tcp_server_impl(size_t threads)
         : work_(new boost::asio::io_service::work(io_service_))
     {
-        run_thread_ = std::make_shared<boost::thread>(boost::bind(&boost::asio::io_service::run, &io_service_));
+        for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+        {
+            run_threads_.push_back(std::make_shared<boost::thread>(boost::bind(&boost::asio::io_service::run, &io_service_)));
+        }
     }
 
     boost::asio::io_service io_service_;                   // asio
     std::shared_ptr<boost::asio::io_service::work> work_;  // ֤run()ûϢʱ˳
     std::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor_ = nullptr;
-    thread_ptr run_thread_;  // run()̣߳߳
+    std::vector<thread_ptr> run_threads_;  // run()̣߳߳
     thread_ptr listen_thread_ = nullptr;
 
     uint16_t port_;
@@ -21,17 +24,20 @@ struct tcp_server::tcp_server_impl
     new_connection_handler new_connection_ = nullptr;
 };
 
-tcp_server::tcp_server()
-    : impl_(new tcp_server_impl)
+tcp_server::tcp_server(size_t threads)
+    : impl_(new tcp_server_impl(threads))
 {
 }
 
 tcp_server::~tcp_server()
 {
     impl_->work_.reset();  // run()ִevent˳
-    impl_->run_thread_->interrupt();
-    impl_->run_thread_->join();
-    impl_->run_thread_.reset();
+    for (auto &thread : impl_->run_threads_)
+    {
+        thread->interrupt();
+        thread->join();
+    }
+    impl_->run_threads_.clear();
 
     // run˳io_serviceԶֹͣ
     if (!impl_->io_service_.stopped())
@@ -19,7 +19,8 @@ using new_connection_handler = std::function<void(sock_ptr)>;
 class tcp_server
 {
 public:
-    tcp_server();
+    /** @param threads  io_service ߳,  1 ʱͬһϵĴҪԼл(strand) */
+    tcp_server(size_t threads = 1);
     virtual ~tcp_server();
 
     bool bind(unsigned short port);
@@ -0,0 +1,224 @@
+// Description: Size-classed slab pool for telemetry message buffers
+
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <boost/intrusive_ptr.hpp>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace cortex
+{
+    class tm_buffer_pool;
+
+    /***************************************************************
+     * @class tm_msg
+     * @brief refcounted message buffer, header and bytes share one pool block
+     ***************************************************************/
+    class tm_msg
+    {
+    public:
+        uint8_t *data()
+        {
+            return reinterpret_cast<uint8_t *>(this + 1);
+        }
+        const uint8_t *data() const
+        {
+            return reinterpret_cast<const uint8_t *>(this + 1);
+        }
+        size_t size() const
+        {
+            return size_;
+        }
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+        uint8_t *begin()
+        {
+            return data();
+        }
+        uint8_t *end()
+        {
+            return data() + size_;
+        }
+        const uint8_t *begin() const
+        {
+            return data();
+        }
+        const uint8_t *end() const
+        {
+            return data() + size_;
+        }
+
+        friend void intrusive_ptr_add_ref(tm_msg *msg)
+        {
+            msg->refs_.fetch_add(1, std::memory_order_relaxed);
+        }
+        friend inline void intrusive_ptr_release(tm_msg *msg);
+
+    private:
+        friend class tm_buffer_pool;
+
+        std::atomic<uint32_t> refs_{ 0 };
+        uint32_t size_{ 0 };
+        int size_class_{ -1 };  // -1: allocated outside the slabs
+        tm_buffer_pool *pool_{ nullptr };
+    };
+    typedef boost::intrusive_ptr<tm_msg> tm_msg_ptr;
+
+    /***************************************************************
+     * @class tm_buffer_pool
+     * @brief blocks of 256B .. 16MB carved from 1MB+ slabs, freed blocks go back to their class
+     * @note  slabs are never returned to the heap, steady state runs without heap allocation
+     ***************************************************************/
+    class tm_buffer_pool
+    {
+    public:
+        struct stats
+        {
+            uint64_t allocations;       // messages handed out
+            uint64_t heap_allocations;  // slabs and oversize blocks taken from the heap
+            uint64_t in_use;            // messages not yet released
+            uint64_t pooled_bytes;      // bytes held by slabs
+        };
+
+        constexpr static size_t MIN_BLOCK = 256;
+        constexpr static size_t CLASS_COUNT = 17;  // 256B << 16 = 16MB
+        constexpr static size_t SLAB_BYTES = 1 << 20;
+
+    public:
+        tm_buffer_pool() = default;
+        tm_buffer_pool(const tm_buffer_pool &) = delete;
+        tm_buffer_pool &operator=(const tm_buffer_pool &) = delete;
+
+        ~tm_buffer_pool()
+        {
+            for (auto slab : slabs_)
+            {
+                ::operator delete(slab);
+            }
+        }
+
+        /** shared pool used by the parsers and the simulator */
+        static tm_buffer_pool &instance()
+        {
+            static tm_buffer_pool pool;
+            return pool;
+        }
+
+    public:
+        /** message of size bytes, content is not initialized */
+        tm_msg_ptr allocate(size_t size)
+        {
+            allocations_++;
+            in_use_++;
+            auto cls = size_class(sizeof(tm_msg) + size);
+            void *block = cls < 0 ? heap_block(sizeof(tm_msg) + size) : pop_block(cls);
+            auto msg = new (block) tm_msg;
+            msg->size_ = (uint32_t)size;
+            msg->size_class_ = cls;
+            msg->pool_ = this;
+            return tm_msg_ptr(msg);
+        }
+
+        tm_msg_ptr copy(const uint8_t *ptr, size_t size)
+        {
+            auto msg = allocate(size);
+            memcpy(msg->data(), ptr, size);
+            return msg;
+        }
+
+        stats status() const
+        {
+            return { allocations_, heap_allocations_, in_use_, pooled_bytes_ };
+        }
+
+    private:
+        friend void intrusive_ptr_release(tm_msg *msg);
+
+        static int size_class(size_t bytes)
+        {
+            size_t block = MIN_BLOCK;
+            for (int cls = 0; cls < (int)CLASS_COUNT; ++cls, block <<= 1)
+            {
+                if (bytes <= block) return cls;
+            }
+            return -1;
+        }
+
+        void *heap_block(size_t bytes)
+        {
+            heap_allocations_++;
+            return ::operator new(bytes);
+        }
+
+        void *pop_block(int cls)
+        {
+            auto &fl = free_[cls];
+            std::scoped_lock lock(fl.mutex);
+            if (fl.blocks.empty())
+            {
+                // carve a new slab into blocks of this class
+                auto block = MIN_BLOCK << cls;
+                auto bytes = std::max(SLAB_BYTES, block);
+                auto slab = static_cast<uint8_t *>(heap_block(bytes));
+                {
+                    std::scoped_lock slab_lock(slab_mutex_);
+                    slabs_.push_back(slab);
+                }
+                pooled_bytes_ += bytes;
+                for (size_t off = 0; off + block <= bytes; off += block)
+                {
+                    fl.blocks.push_back(slab + off);
+                }
+            }
+            auto block = fl.blocks.back();
+            fl.blocks.pop_back();
+            return block;
+        }
+
+        void release(tm_msg *msg)
+        {
+            in_use_--;
+            auto cls = msg->size_class_;
+            msg->~tm_msg();
+            if (cls < 0)
+            {
+                ::operator delete(msg);
+                return;
+            }
+            auto &fl = free_[cls];
+            std::scoped_lock lock(fl.mutex);
+            fl.blocks.push_back(msg);
+        }
+
+    private:
+        struct free_list
+        {
+            std::mutex mutex;
+            std::vector<void *> blocks;
+        };
+        std::array<free_list, CLASS_COUNT> free_;
+        std::mutex slab_mutex_;
+        std::vector<uint8_t *> slabs_;
+
+        std::atomic<uint64_t> allocations_{ 0 };
+        std::atomic<uint64_t> heap_allocations_{ 0 };
+        std::atomic<uint64_t> in_use_{ 0 };
+        std::atomic<uint64_t> pooled_bytes_{ 0 };
+    };
+
+    inline void intrusive_ptr_release(tm_msg *msg)
+    {
+        if (msg->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            msg->pool_->release(msg);
+        }
+    }
+}  // namespace cortex
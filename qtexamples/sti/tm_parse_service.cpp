@@ -0,0 +1,290 @@
+﻿#include "tm_parse_service.h"
+#include "lockfree_spsc_queue.h"
+#include "sti_framer.h"
+#include <chrono>
+#include <iostream>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+const static int STEPS_PER_VISIT = 16;         // 每次轮到一条链路时最多解析的步数, 避免一条繁忙链路饿死同线程的其他链路
+const static size_t LATENCY_MARKS = 1024;      // 每条链路记录时延的采样点个数, 满了就不再采样
+
+namespace cortex
+{
+    static int64_t steady_now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void pin_thread(std::thread &thread, size_t core)
+    {
+#ifdef _WIN32
+        SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << (core % (sizeof(DWORD_PTR) * 8)));
+#else
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core % CPU_SETSIZE, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#endif
+    }
+
+    struct tm_link_t
+    {
+        // 时延采样点: 接收到第 end 个字节的时间
+        struct latency_mark
+        {
+            uint64_t end;
+            int64_t ns;
+        };
+
+        tm_link_t(int worker, const tm_link_options &opts, const tm_frames_callback_fun_t &fun)
+            : worker_(worker)
+            , opts_(opts)
+            , fun_(fun)
+            , data_buf_(opts.capacity)
+            , marks_(LATENCY_MARKS)
+        {
+        }
+
+        // 以下在接收线程调用
+        void push(const uint8_t *data, size_t len)
+        {
+            auto end = data_buf_.push(data, data + len);
+            auto pushed = size_t(end - data);
+            lost_count_ += len - pushed;
+            if (pushed > 0)
+            {
+                pushed_bytes_ += pushed;
+                marks_.push({ pushed_bytes_, steady_now_ns() });
+            }
+        }
+
+        // 以下在解析线程调用
+        bool ready() const
+        {
+            return data_buf_.read_available() >= std::min(framer_.need(), data_buf_.capacity());
+        }
+
+        bool step()
+        {
+            auto on_msg = [this](const uint8_t *msg, size_t len) {
+                on_tm_msg(msg, len);
+            };
+            return framer_.step(data_buf_, on_msg, error_count_);
+        }
+
+        void on_tm_msg(const uint8_t *msg, size_t len)
+        {
+            msg_count_++;
+            auto count = opts_.type == tm_link_type::hdr ? hdr_tm_parser::extract_frames(msg, len, opts_.time_code, frames_)
+                                                         : crt_tm_parser::extract_frames(msg, len, opts_.time_code, frames_);
+            frame_count_ += count;
+            if (count > 0 && fun_)
+            {
+                fun_(tm_buffer_pool::instance().copy(msg, len), frames_);
+            }
+        }
+
+        // 收回已经解析完的采样点, 记录时延
+        void update_latency()
+        {
+            auto marks = marks_.read_span(0, false);
+            if (marks.empty()) return;
+            auto parsed = framer_.consumed();
+            size_t n = 0;
+            while (n < marks.size() && marks[n].end <= parsed)
+            {
+                n++;
+            }
+            if (n == 0) return;
+            auto ns = steady_now_ns();
+            for (size_t i = 0; i < n; ++i)
+            {
+                auto latency = uint64_t(ns - marks[i].ns);
+                latency_sum_ns_ += latency;
+                if (latency > latency_max_ns_) latency_max_ns_ = latency;
+            }
+            latency_count_ += n;
+            marks_.consume(n);
+        }
+
+        void reset()
+        {
+            data_buf_.reset();
+            marks_.reset();
+            framer_.reset();
+            pushed_bytes_ = 0;
+        }
+
+        const int worker_;
+        const tm_link_options opts_;
+        const tm_frames_callback_fun_t fun_;
+
+        std::atomic_uint64_t lost_count_ = 0;
+        std::atomic_uint64_t msg_count_ = 0;
+        std::atomic_uint64_t frame_count_ = 0;
+        std::atomic_uint64_t error_count_ = 0;
+        std::atomic_uint64_t latency_sum_ns_ = 0;
+        std::atomic_uint64_t latency_count_ = 0;
+        std::atomic_uint64_t latency_max_ns_ = 0;
+
+        // 解析线程同时看多条链路, 由所属 worker 统一等待, 缓存本身从不阻塞
+        lockfree_spsc_queue<uint8_t, spsc_wait::busy_spin> data_buf_;
+        lockfree_spsc_queue<latency_mark, spsc_wait::busy_spin> marks_;
+        uint64_t pushed_bytes_ = 0;            // 只在接收线程使用
+        sti_stream_framer framer_;             // 只在解析线程使用
+        std::vector<tm_frame_desc> frames_;    // 只在解析线程使用, 重复利用
+    };
+
+    struct tm_parse_worker_t
+    {
+        bool any_ready() const
+        {
+            for (auto link : links_)
+            {
+                if (link->ready()) return true;
+            }
+            return false;
+        }
+
+        std::vector<tm_link_t *> links_;
+        spsc_wait::spin_park<> wait_;  // 任一链路有数据时由接收线程唤醒
+        std::thread thread_;
+    };
+
+    struct tm_parse_service::tm_parse_service_imp_t
+    {
+        void run(tm_parse_worker_t &worker)
+        {
+            try
+            {
+                while (is_running_)
+                {
+                    bool busy = false;
+                    for (auto link : worker.links_)
+                    {
+                        for (int i = 0; i < STEPS_PER_VISIT && link->step(); ++i)
+                        {
+                            busy = true;
+                        }
+                        link->update_latency();
+                    }
+                    if (!busy)
+                    {
+                        worker.wait_.wait([&worker, this] {
+                            return !is_running_ || worker.any_ready();
+                        });
+                    }
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "[tm_parse_service] catch: " << e.what() << std::endl;
+            }
+        }
+
+        bool pin_threads_ = false;
+        std::atomic_bool is_running_ = false;
+        std::vector<std::unique_ptr<tm_link_t>> links_;
+        std::vector<std::unique_ptr<tm_parse_worker_t>> workers_;
+    };
+
+    tm_parse_service::tm_parse_service(size_t workers, bool pin_threads)
+        : imp_(new tm_parse_service_imp_t)
+    {
+        if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+        imp_->pin_threads_ = pin_threads;
+        for (size_t i = 0; i < workers; ++i)
+        {
+            imp_->workers_.push_back(std::make_unique<tm_parse_worker_t>());
+        }
+    }
+
+    tm_parse_service::~tm_parse_service()
+    {
+        stop();
+    }
+
+    int tm_parse_service::add_link(const tm_link_options &opts, const tm_frames_callback_fun_t &fun)
+    {
+        if (imp_->is_running_) return -1;
+        // 按添加顺序轮流分配, 链路速率相近时各线程负载均衡
+        auto id = (int)imp_->links_.size();
+        auto worker = id % (int)imp_->workers_.size();
+        imp_->links_.push_back(std::make_unique<tm_link_t>(worker, opts, fun));
+        imp_->workers_[worker]->links_.push_back(imp_->links_.back().get());
+        return id;
+    }
+
+    bool tm_parse_service::is_running() const
+    {
+        return imp_->is_running_;
+    }
+
+    void tm_parse_service::start()
+    {
+        if (!imp_->is_running_)
+        {
+            imp_->is_running_ = true;
+            for (size_t i = 0; i < imp_->workers_.size(); ++i)
+            {
+                auto &worker = *imp_->workers_[i];
+                if (worker.links_.empty()) continue;
+                worker.thread_ = std::thread([this, &worker]() {
+                    imp_->run(worker);
+                });
+                if (imp_->pin_threads_) pin_thread(worker.thread_, i);
+            }
+        }
+    }
+
+    void tm_parse_service::stop()
+    {
+        if (imp_->is_running_)
+        {
+            imp_->is_running_ = false;
+            for (auto &worker : imp_->workers_)
+            {
+                if (worker->thread_.joinable())
+                {
+                    worker->wait_.notify_all();
+                    worker->thread_.join();
+                }
+            }
+            for (auto &link : imp_->links_)
+            {
+                link->reset();
+            }
+        }
+    }
+
+    void tm_parse_service::push_data(int link, const uint8_t *data, size_t len)
+    {
+        if (link < 0 || link >= (int)imp_->links_.size() || len == 0) return;
+        auto &l = *imp_->links_[link];
+        l.push(data, len);
+        imp_->workers_[l.worker_]->wait_.notify();
+    }
+
+    size_t tm_parse_service::link_count() const
+    {
+        return imp_->links_.size();
+    }
+
+    size_t tm_parse_service::worker_count() const
+    {
+        return imp_->workers_.size();
+    }
+
+    tm_parse_service::link_status tm_parse_service::get_link_status(int link) const
+    {
+        if (link < 0 || link >= (int)imp_->links_.size()) return {};
+        auto &l = *imp_->links_[link];
+        uint64_t count = l.latency_count_;
+        return link_status{ l.worker_, l.data_buf_.capacity(), l.data_buf_.used_size(), l.lost_count_, l.msg_count_, l.frame_count_,
+            l.error_count_, count ? l.latency_sum_ns_ / 1e3 / count : 0.0, l.latency_max_ns_ / 1e3 };
+    }
+}  // namespace cortex
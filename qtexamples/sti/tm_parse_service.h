@@ -0,0 +1,76 @@
+﻿// Description: Provide a multi-link telemetry parser backed by a worker pool
+
+#pragma once
+#pragma warning(disable : 4251)
+#pragma warning(disable : 4996)
+
+#include "cortex_tm_parser.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace cortex
+{
+    enum class tm_link_type
+    {
+        hdr,
+        crt,
+    };
+
+    struct tm_link_options
+    {
+        tm_link_type type = tm_link_type::crt;
+        int time_code = 0;
+        size_t capacity = 16 * 1024 * 1024;  // 接收环形缓存字节数
+    };
+
+    /***************************************************************
+     * @class tm_parse_service
+     * @brief 多路遥测链路共用一组解析线程: 组包(sti)和拆帧(hdr/crt)在同一个线程里完成.
+     * @note  每条链路固定分给一个线程, 链路内的消息按到达顺序回调; 不同链路的回调在不同线程里并发.
+     *        每条链路只允许一个线程调用 push_data.
+     ***************************************************************/
+    class tm_parse_service
+    {
+    public:
+        /**
+         * @param workers 解析线程数, 0 表示 CPU 核数
+         * @param pin_threads 第 i 个解析线程绑定到第 i 个核
+         */
+        tm_parse_service(size_t workers = 0, bool pin_threads = false);
+        virtual ~tm_parse_service();
+
+        /** 添加链路, 只能在 start 之前调用, 返回链路号; fun 在该链路所属的解析线程里调用 */
+        int add_link(const tm_link_options &opts, const tm_frames_callback_fun_t &fun);
+
+        bool is_running() const;
+        void start();
+        void stop();
+        void push_data(int link, const uint8_t *data, size_t len);
+        void push_data(int link, iterator_type begin, iterator_type end)
+        {
+            push_data(link, &*begin, end - begin);
+        }
+
+        struct link_status
+        {
+            int worker;            // 所属解析线程
+            size_t capacity;       // 接收缓存字节数
+            size_t backlog;        // 未解析的字节数
+            uint64_t lost;         // 缓存满时丢弃的字节数
+            uint64_t messages;     // 已解析出的消息数
+            uint64_t frames;       // 已解析出的遥测帧数
+            uint64_t errors;       // 帧格式错误数
+            double latency_avg_us; // push_data 到消息回调结束的平均时延
+            double latency_max_us; // 同上, 最大值
+        };
+        size_t link_count() const;
+        size_t worker_count() const;
+        link_status get_link_status(int link) const;
+
+    private:
+        struct tm_parse_service_imp_t;
+        std::shared_ptr<tm_parse_service_imp_t> imp_;
+    };
+    typedef std::shared_ptr<tm_parse_service> tm_parse_service_ptr;
+}  // namespace cortex
@@ -1,69 +1,315 @@
 #include "tm_server.h"
-#include "tm_thread.h"
+#include "shm_ring.h"
+#include "tm_session.h"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <thread>
+
+using subscribers_ptr = std::shared_ptr<const std::vector<tm_session_ptr>>;
+using boost::asio::ip::udp;
+
+static const int crtTail = SwapEndian32(-1234567890);
+
+//TCP ֮ķĿ(UDPڴ), ÿ֡һ CRT Ϣ: ֻͨ push ʹ(push_mutex )
+struct crt_target
+{
+    crt_target(const tm_server::channel &channel)
+        : header_(tm_session::make_header(tm_session::protocol_type::CRT, channel))
+        , frameBytes_(SwapEndian32(header_[1]) - 68)
+        , pad_(frameBytes_, 0)
+    {
+    }
+    virtual ~crt_target() = default;
+
+    virtual std::string name() const = 0;
+    virtual void send(const cortex::tm_msg_ptr &frameAddTime) = 0;
+
+    //Ϣͷʱ, ֡Ч, ͨ֡Ĳ pad_ 
+    size_t prepare(const cortex::tm_msg_ptr &frameAddTime)
+    {
+        //ʱ䰴CODE0, ȡ֡β; Ÿնͳƶ
+        memcpy(&header_[3], frameAddTime->data() + frameAddTime->size() - sizeof(double), sizeof(double));
+        header_[5] = SwapEndian32(int(seq_++));
+        return std::min(frameAddTime->size() - sizeof(double), frameBytes_);
+    }
+
+    std::vector<int> header_;
+    size_t frameBytes_;
+    std::vector<uint8_t> pad_;  // ֡ͨ֡ʱ 0
+    uint32_t seq_ = 0;
+    std::atomic_uint64_t sent_ = 0;
+    std::atomic_uint64_t errors_ = 0;
+};
+
+//һ UDP Ŀ
+struct udp_target : crt_target
+{
+    udp_target(boost::asio::io_service &io, const udp::endpoint &endpoint, const tm_server::channel &channel)
+        : crt_target(channel)
+        , socket_(io, udp::v4())
+        , endpoint_(endpoint)
+    {
+    }
+
+    std::string name() const override
+    {
+        return endpoint_.address().to_string() + ":" + std::to_string(endpoint_.port());
+    }
+
+    void send(const cortex::tm_msg_ptr &frameAddTime) override
+    {
+        auto len = prepare(frameAddTime);
+        //ֱ֡óػ, ͷ֡βһ sendmsg 
+        std::array<boost::asio::const_buffer, 4> buffers{ boost::asio::buffer(header_.data(), header_.size() * sizeof(int)),
+            boost::asio::buffer(frameAddTime->data(), len), boost::asio::buffer(pad_.data(), frameBytes_ - len), boost::asio::buffer(&crtTail, sizeof(crtTail)) };
+        boost::system::error_code ec;
+        socket_.send_to(buffers, endpoint_, 0, ec);
+        if (ec)
+            errors_++;
+        else
+            sent_++;
+    }
+
+    udp::socket socket_;
+    udp::endpoint endpoint_;
+};
+
+//һڴ淢Ŀ: ͬһϵĽն˸԰α, Эջ, ÿֻ֡һεڴ
+struct shm_target : crt_target
+{
+    using crt_target::crt_target;
+
+    std::string name() const override
+    {
+        return "shm:" + ring_.name();
+    }
+
+    void send(const cortex::tm_msg_ptr &frameAddTime) override
+    {
+        auto len = prepare(frameAddTime);
+        if (ring_.write({ { (const uint8_t *)header_.data(), header_.size() * sizeof(int) }, { frameAddTime->data(), len }, { pad_.data(), frameBytes_ - len },
+                { (const uint8_t *)&crtTail, sizeof(crtTail) } }))
+            sent_++;
+        else
+            errors_++;
+    }
+
+    cortex::shm_ring_writer ring_;
+};
+
+//һңͨ: бԲɱշ, push ֻղ, ӱ仯ʱһ滻
+struct channel_entry
+{
+    tm_server::channel config;
+    std::mutex push_mutex;  //ͬһͨĶ֮䴮(Ựǵ), ӽ/Ͽ޹
+    std::atomic<subscribers_ptr> subscribers{ std::make_shared<const std::vector<tm_session_ptr>>() };
+    std::vector<std::unique_ptr<crt_target>> targets;  //UDP/ڴĿ, start ֮ǰ, ֻ֮
+};
 
 struct tm_server::tm_server_impl
 {
-    std::mutex mutex_;
-    std::map<int, channel> channels_;
-    std::vector<sock_ptr> socks_;                //ӵsocket
-    std::map<sock_ptr, data_ptr> readBufs_;      //ӵsocketȡݻ
-    std::map<sock_ptr, tm_thread_ptr> threads_;  //ʽȷsocketʹ߳
+    std::mutex mutex_;                                         //ֻصı, ·ʹ
+    std::map<int, std::unique_ptr<channel_entry>> channels_;  //start ֮ǰע, ֻ֮
+    std::vector<sock_ptr> socks_;                   //ӵsocket
+    std::map<sock_ptr, data_ptr> readBufs_;         //ӵsocketȡݻ
+    std::map<sock_ptr, tm_session_ptr> sessions_;  //ʽȷsocketʹķͻỰ
+    std::map<sock_ptr, std::string> peers_;         //ͻ˵ַ, ͳ
+
+    // mutex_ ڵ: ƶб, ޸ĺ滻, ɿһ߷ֺͷ
+    template <class F>
+    void update_subscribers(int channel, F &&modify)
+    {
+        auto iter = channels_.find(channel);
+        if (iter == channels_.end()) return;
+        auto &subscribers = iter->second->subscribers;
+        auto next = std::make_shared<std::vector<tm_session_ptr>>(*subscribers.load());
+        modify(*next);
+        subscribers.store(std::move(next));
+    }
+
+    //ӶϿͷŸÿͻ˵Դ
+    void remove(const sock_ptr &socket)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto session = sessions_.find(socket);
+        if (session != sessions_.end())
+        {
+            update_subscribers(session->second->channel().id, [&session](auto &list) {
+                list.erase(std::remove(list.begin(), list.end(), session->second), list.end());
+            });
+            sessions_.erase(session);
+        }
+        peers_.erase(socket);
+        readBufs_.erase(socket);
+        auto iter = std::find(socks_.begin(), socks_.end(), socket);
+        if (iter != socks_.end()) socks_.erase(iter);
+    }
 };
 
-tm_server::tm_server()
-    : impl_(new tm_server_impl)
+tm_server::tm_server(size_t threads)
+    : tcp_server(threads ? threads : std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 4))
+    , impl_(new tm_server_impl)
 {
     tcp_server::bind_new_connection_handler([&](sock_ptr socket) {
         // emit clientConnected(socket);
-        impl_->socks_.push_back(socket);
-        impl_->readBufs_[socket] = std::make_shared<std::vector<uint8_t>>(1024, 0x0);
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex_);
+            impl_->socks_.push_back(socket);
+            impl_->readBufs_[socket] = std::make_shared<std::vector<uint8_t>>(1024, 0x0);
+            boost::system::error_code ec;
+            auto ep = socket->remote_endpoint(ec);
+            impl_->peers_[socket] = ec ? std::string() : ep.address().to_string() + ":" + std::to_string(ep.port());
+        }
         check_connection(socket);
     });
 }
 
 void tm_server::register_channel(const channel &ch)
 {
-    impl_->channels_[ch.id] = ch;
+    auto &entry = impl_->channels_[ch.id];
+    if (!entry) entry = std::make_unique<channel_entry>();
+    entry->config = ch;
 }
 
 void tm_server::stop()
 {
     tcp_server::stop();
     //ֹͣʱͷԴ
-    for (auto &pair : impl_->threads_)
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    for (auto &pair : impl_->sessions_)
     {
         pair.second->stop();
     }
     for (auto &socket : impl_->socks_)
     {
-        if (socket->is_open())
+        if (socket->is_open() && impl_->sessions_.find(socket) == impl_->sessions_.end())
         {
-            socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both);
-            socket->close();
+            boost::system::error_code ec;
+            socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+            socket->close(ec);
         }
     }
     impl_->socks_.clear();
     impl_->readBufs_.clear();
-    impl_->threads_.clear();
+    impl_->sessions_.clear();
+    impl_->peers_.clear();
+    for (auto &pair : impl_->channels_)
+    {
+        pair.second->subscribers.store(std::make_shared<const std::vector<tm_session_ptr>>());
+    }
 }
 
 void tm_server::push(int channel, uint64_t time, data_ptr frame)
 {
-    impl_->mutex_.lock();
-    for (auto &pair : impl_->threads_)
+    push(channel, time, frame->data(), frame->size());
+}
+
+void tm_server::push(int channel, uint64_t time, const uint8_t *frame, size_t len)
+{
+    auto iter = impl_->channels_.find(channel);
+    if (iter == impl_->channels_.end()) return;
+    auto &entry = *iter->second;
+    //ֻȡͨߵĿ, ӽͶϿ
+    auto subscribers = entry.subscribers.load();
+    if (subscribers->empty() && entry.targets.empty()) return;
+
+    //ͬһЭĴʱֻ֡һ, пͻ˹ͬһ黺
+    cortex::tm_msg_ptr frames[2];
+    std::lock_guard<std::mutex> lock(entry.push_mutex);
+    for (auto &session : *subscribers)
     {
-        auto thread = pair.second;
-        if (thread->channel().id == channel)
+        auto ptype = session->protocol();
+        auto &frameAddTime = frames[(int)ptype];
+        if (!frameAddTime) frameAddTime = tm_session::make_frame(ptype, time, frame, len);
+        session->push(frameAddTime);
+    }
+    for (auto &target : entry.targets)
+    {
+        auto &frameAddTime = frames[(int)tm_session::protocol_type::CRT];
+        if (!frameAddTime) frameAddTime = tm_session::make_frame(tm_session::protocol_type::CRT, time, frame, len);
+        target->send(frameAddTime);
+    }
+}
+
+bool tm_server::add_udp_target(int channel, const std::string &address, uint16_t port, const std::string &iface, int ttl)
+{
+    auto iter = impl_->channels_.find(channel);
+    if (iter == impl_->channels_.end()) return false;
+    boost::system::error_code ec;
+    auto addr = boost::asio::ip::make_address_v4(address, ec);
+    if (ec)
+    {
+        std::cerr << address << ": " << ec.message() << std::endl;
+        return false;
+    }
+    auto target = std::make_unique<udp_target>(io_service(), udp::endpoint(addr, port), iter->second->config);
+    auto &socket = target->socket_;
+    socket.set_option(boost::asio::socket_base::send_buffer_size(4 << 20), ec);
+    if (addr.is_multicast())
+    {
+        socket.set_option(boost::asio::ip::multicast::hops(ttl), ec);
+        socket.set_option(boost::asio::ip::multicast::enable_loopback(true), ec);  //ĽնҲյ
+        if (!iface.empty())
+        {
+            socket.set_option(boost::asio::ip::multicast::outbound_interface(boost::asio::ip::make_address_v4(iface, ec)), ec);
+            if (ec)
+            {
+                std::cerr << iface << ": " << ec.message() << std::endl;
+                return false;
+            }
+        }
+    }
+    iter->second->targets.push_back(std::move(target));
+    return true;
+}
+
+bool tm_server::add_shm_target(int channel, const std::string &name, size_t capacity)
+{
+    auto iter = impl_->channels_.find(channel);
+    if (iter == impl_->channels_.end()) return false;
+    auto target = std::make_unique<shm_target>(iter->second->config);
+    if (!target->ring_.create(name, capacity)) return false;
+    iter->second->targets.push_back(std::move(target));
+    return true;
+}
+
+std::vector<tm_server::target_status> tm_server::get_target_status() const
+{
+    std::vector<target_status> result;
+    for (auto &pair : impl_->channels_)
+    {
+        for (auto &target : pair.second->targets)
         {
-            thread->push(time, frame);
+            result.push_back({ target->name(), pair.first, target->sent_, target->errors_ });
         }
     }
-    impl_->mutex_.unlock();
+    return result;
+}
+
+std::vector<tm_server::client_status> tm_server::get_client_status() const
+{
+    std::vector<client_status> result;
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    for (auto &pair : impl_->sessions_)
+    {
+        auto st = pair.second->get_status();
+        result.push_back({ impl_->peers_[pair.first], pair.second->channel().id, st.sent, st.lost, st.queued, st.lag_avg_ms, st.lag_max_ms,
+            st.copied, st.syscalls });
+    }
+    return result;
 }
 
 void tm_server::check_connection(sock_ptr socket)
 {
-    socket->async_read_some(boost::asio::buffer(*impl_->readBufs_[socket]),
+    data_ptr buf;
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        auto iter = impl_->readBufs_.find(socket);
+        if (iter == impl_->readBufs_.end()) return;
+        buf = iter->second;
+    }
+    socket->async_read_some(boost::asio::buffer(*buf),
         boost::bind(&tm_server::read_handler, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred, socket));
 }
 
@@ -72,87 +318,83 @@ void tm_server::read_handler(const boost::system::error_code &ec, size_t bytes_t
     if (!tcp_server::is_running())
         return;
     if (ec)
-    {  //ͻϿ
+    {  //ͻң֮ǰϿ
         // socket->remote_endpoint().address().to_string()
         // socket->remote_endpoint().port()
-
-        impl_->mutex_.lock();
-        //ÿͻ˶Ӧ߳
-        auto iter = impl_->threads_.find(socket);
-        if (iter != impl_->threads_.end())
+        try
         {
-            impl_->threads_[socket]->stop();
-            try
+            if (socket->is_open())
             {
-                if (socket->is_open())
-                {
-                    socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both);
-                    socket->close();
-                }
+                socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both);
+                socket->close();
             }
-            catch (const std::exception &e)
-            {
-                printf("%s\n", e.what());
-            }
-            impl_->threads_.erase(iter);
+        }
+        catch (const std::exception &e)
+        {
+            printf("%s\n", e.what());
         }
         //¿ͻб
-        impl_->socks_.erase(std::find(impl_->socks_.begin(), impl_->socks_.end(), socket));
-        impl_->readBufs_.erase(impl_->readBufs_.find(socket));
-
-        impl_->mutex_.unlock();
+        impl_->remove(socket);
+        return;
     }
-    else
-    {  //ң
-        auto ptr = (int *)impl_->readBufs_[socket]->data();
-        auto channel = SwapEndian32(ptr[3]);
 
-        if (128 == bytes_transferred && SwapEndian32(ptr[0]) == 1234567890 && SwapEndian32(ptr[1]) == bytes_transferred && SwapEndian32(ptr[31]) == -1234567890)
-        {  // HDR
+    //ң
+    data_ptr buf;
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        buf = impl_->readBufs_[socket];
+    }
+    auto ptr = (int *)buf->data();
+    auto channel = SwapEndian32(ptr[3]);
 
-            if (impl_->channels_.find(channel) != impl_->channels_.end())
-            {
-                impl_->mutex_.lock();
-                //жң߳ǷѾ
-                if (impl_->threads_.find(socket) == impl_->threads_.end())
-                {
-                    impl_->channels_[channel].block_num = SwapEndian32(ptr[8]);
-                    tm_thread_ptr thread(new tm_thread(tm_thread::protocol_type::HDR, impl_->channels_[channel], socket));
-                    thread->start();
-                    impl_->threads_[socket] = thread;
-                }
-                impl_->mutex_.unlock();
-            }
-        }
-        else if (64 == bytes_transferred && SwapEndian32(ptr[0]) == 1234567890 && SwapEndian32(ptr[1]) == bytes_transferred &&
-                 SwapEndian32(ptr[15]) == -1234567890)
-        {  // CRT&&RTR
+    tm_session::protocol_type ptype;
+    int block_num = 1;
+    if (128 == bytes_transferred && SwapEndian32(ptr[0]) == 1234567890 && SwapEndian32(ptr[1]) == bytes_transferred && SwapEndian32(ptr[31]) == -1234567890)
+    {  // HDR
+        ptype = tm_session::protocol_type::HDR;
+        block_num = SwapEndian32(ptr[8]);
+    }
+    else if (64 == bytes_transferred && SwapEndian32(ptr[0]) == 1234567890 && SwapEndian32(ptr[1]) == bytes_transferred &&
+             SwapEndian32(ptr[15]) == -1234567890)
+    {  // CRT&&RTR
+        ptype = tm_session::protocol_type::CRT;
+    }
+    else
+    {
+        std::vector<int> negativeReplyMsg(5);
+        negativeReplyMsg[0] = SwapEndian32(1234567890);
+        negativeReplyMsg[1] = SwapEndian32(20);
+        negativeReplyMsg[2] = SwapEndian32(ptr[2]);
+        negativeReplyMsg[3] = SwapEndian32(1);  // Bad syntax
+        negativeReplyMsg[4] = SwapEndian32(-1234567890);
+        //ңӦ
+        boost::system::error_code ec;
+        socket->write_some(boost::asio::buffer(negativeReplyMsg), ec);
+        check_connection(socket);
+        return;
+    }
 
-            if (impl_->channels_.find(channel) != impl_->channels_.end())
-            {
-                impl_->mutex_.lock();
-                if (impl_->threads_.find(socket) == impl_->threads_.end())
-                {
-                    impl_->channels_[channel].block_num = 1;
-                    tm_thread_ptr thread(new tm_thread(tm_thread::protocol_type::CRT, impl_->channels_[channel], socket));
-                    thread->start();
-                    impl_->threads_[socket] = thread;
-                }
-                impl_->mutex_.unlock();
-            }
-        }
-        else
-        {
-            std::vector<int> negativeReplyMsg(5);
-            negativeReplyMsg[0] = SwapEndian32(1234567890);
-            negativeReplyMsg[1] = SwapEndian32(20);
-            negativeReplyMsg[2] = SwapEndian32(ptr[2]);
-            negativeReplyMsg[3] = SwapEndian32(1);  // Bad syntax
-            negativeReplyMsg[4] = SwapEndian32(-1234567890);
-            //ңӦ
-            boost::system::error_code ec;
-            socket->write_some(boost::asio::buffer(negativeReplyMsg), ec);
-        }
+    std::unique_lock<std::mutex> lock(impl_->mutex_);
+    auto ch = impl_->channels_.find(channel);
+    if (ch == impl_->channels_.end() || impl_->sessions_.find(socket) != impl_->sessions_.end())
+    {
+        lock.unlock();
         check_connection(socket);
+        return;
     }
+    //ʽȷ, ֮ӵĶдͻỰ
+    auto ch_config = ch->second->config;
+    ch_config.block_num = block_num;
+    auto session = std::make_shared<tm_session>(ptype, ch_config, socket);
+    impl_->sessions_[socket] = session;
+    impl_->update_subscribers(channel, [&session](auto &list) {
+        list.push_back(session);
+    });
+    std::weak_ptr<tm_server_impl> weak = impl_;
+    session->start([weak](const tm_session_ptr &session) {
+        if (auto impl = weak.lock())
+        {
+            impl->remove(session->socket());
+        }
+    });
 }
@@ -7,7 +7,8 @@ using data_ptr = std::shared_ptr<std::vector<unsigned char>>;
 class tm_server : public tcp_server
 {
 public:
-    tm_server();
+    /** @param threads ߳, пͻ˹, 0 ʾ CPU ȡ 1~4 */
+    tm_server(size_t threads = 0);
     ~tm_server() = default;
 
     struct channel
@@ -17,6 +18,7 @@ public:
         int frame_len;  // in bytes
         int block_num;  // ignored
     };
+    /** עңͨ, ֻ start ֮ǰ; ֻ֮ͨ, push ʱ */
     void register_channel(const channel &ch);
 
     using tcp_server::bind;
@@ -26,11 +28,53 @@ public:
     void stop() override;
     /**
      * @brief ң֡
+     * @note  ֻȡͨߵĿ, ͻ/Ͽ; ͬͨ push 
      * @param[in] channel ңͨ
      * @param[in] ms      ֡Ӧʱ
      * @param[in] frame   ң֡
      */
     void push(int channel, uint64_t ms, data_ptr frame);
+    /** ͬ, ֡ݿػ, ÷Ҫٷ */
+    void push(int channel, uint64_t ms, const uint8_t *frame, size_t len);
+
+    /**
+     * @brief ͨңͬʱ UDP ͵ address:port(鲥ַ򵥲ַ), ÿ֡һ CRT Ϣ, Ϣͷ 6 ǵ
+     * @note  鲥ʱն˸ӷ͸, նҲᷴѹ; ֻ start ֮ǰ
+     * @param[in] iface 鲥ĸַ, ձʾϵͳĬ
+     * @param[in] ttl   鲥, 1 ʾ
+     */
+    bool add_udp_target(int channel, const std::string &address, uint16_t port, const std::string &iface = "", int ttl = 1);
+    /**
+     * @brief ͨңͬʱдΪ name Ĺڴ滷λ, Ϣ TCP/UDP  CRT Ϣͬ, ͬһϵ sti_reader  "shm:name" ȡ
+     * @note  һд˶, Լα껥Ӱ; ֻᱻ(֡), ᷴѹ; ûжʱ; ֻ start ֮ǰ
+     * @param[in] capacity λֽ, ȡ 2 
+     */
+    bool add_shm_target(int channel, const std::string &name, size_t capacity = 64 << 20);
+
+    struct target_status
+    {
+        std::string target;  // address:port  shm:name
+        int channel;
+        uint64_t sent;       // ѷ͵Ϣ
+        uint64_t errors;     // ʧ
+    };
+    /** UDP ͹ڴĿķͳ */
+    std::vector<target_status> get_target_status() const;
+
+    struct client_status
+    {
+        std::string peer;   // ͻ˵ַ
+        int channel;
+        uint64_t sent;      // ѷ͵֡
+        uint64_t lost;      // Ͷ֡
+        size_t queued;      // Ŷӵȴ͵֡
+        double lag_avg_ms;  // ֡뵽ɵƽʱ
+        double lag_max_ms;
+        uint64_t copied;    // ֽ,  sent ÿֽ֡
+        uint64_t syscalls;  // Ƶķ͵ô
+    };
+    /** ǰпͻ˵ķͳ, ڽնѹ */
+    std::vector<client_status> get_client_status() const;
 
 private:
     void check_connection(sock_ptr socket);
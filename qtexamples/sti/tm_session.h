@@ -0,0 +1,117 @@
+﻿#pragma once
+#pragma warning(disable : 4996)
+
+#include "lockfree_spsc_queue.h"
+#include "tm_buffer_pool.h"
+#include "tm_server.h"
+#include <array>
+#include <functional>
+
+/***************************************************************
+ * @class tm_session
+ * @brief 一个遥测客户端的模拟发送: 帧排队后由 io_service 线程异步发送, 不占用独立线程.
+ * @note  push 可以在任意线程调用, 但不能并发(tm_server 按通道串行调用);
+ *        发送和断线处理都在该连接的 strand 上执行.
+ ***************************************************************/
+class tm_session : public std::enable_shared_from_this<tm_session>
+{
+public:
+    enum class protocol_type
+    {
+        CRT,
+        HDR
+    };
+    using close_handler = std::function<void(const std::shared_ptr<tm_session> &)>;
+
+    tm_session(protocol_type ptype, tm_server::channel channel, sock_ptr socket, size_t queue_capacity = 4096);
+    ~tm_session();
+
+public:
+    /** 开始监听断线, on_close 在连接断开或出错后调用一次 */
+    void start(const close_handler &on_close);
+    void stop();
+
+    /** 放入一帧 make_frame 生成的带时间帧, 同一帧可以放入多个连接 */
+    void push(const cortex::tm_msg_ptr &frame);
+
+    /**
+     * 按协议的对齐把帧补齐, 尾部追加 8 字节 CODE0 时间(年积秒, 毫秒)
+     * @param epoch_ms 1970 起的毫秒
+     */
+    static cortex::tm_msg_ptr make_frame(protocol_type ptype, uint64_t epoch_ms, const uint8_t *frame, size_t len);
+    /** 消息头的固定部分(CRT 16 个字, HDR 19 个字), 时间、序号等按消息填写 */
+    static std::vector<int> make_header(protocol_type ptype, const tm_server::channel &channel);
+
+    protocol_type protocol() const;
+    tm_server::channel channel() const;
+    sock_ptr socket() const;
+
+    struct status
+    {
+        uint64_t sent;        // 已发送的帧数
+        uint64_t lost;        // 队列满丢弃的帧数
+        size_t queued;        // 排队等待发送的帧数
+        double lag_avg_ms;    // push 到写完成的平均时延
+        double lag_max_ms;    // 同上, 最大值
+        uint64_t copied;      // 组包时拷贝的字节数(消息头, 尾, 补齐, 短帧), 长帧只引用不拷贝
+        uint64_t writes;      // 异步写次数
+        uint64_t syscalls;    // 估计的发送调用次数, 每次最多 64 段
+    };
+    status get_status() const;
+
+private:
+    struct queued_frame
+    {
+        cortex::tm_msg_ptr frame;
+        int64_t push_ns;
+    };
+
+    void do_read();
+    void do_write();
+    void on_write(const boost::system::error_code &ec, int64_t oldest_ns, size_t frames);
+    /** 把排队的帧组成消息放入 gather_, 返回帧数; HDR 只发送凑满 block_num 的消息 */
+    size_t fill_crt(int64_t &oldest_ns);
+    size_t fill_hdr(int64_t &oldest_ns);
+    // 组包: 消息头尾等小段拷贝到 glue_, 长帧只引用池化缓存
+    uint8_t *add_glue(size_t len);
+    void add_frame(const cortex::tm_msg_ptr &frame, size_t len);
+    void build_gather();
+    bool ready() const;
+    void close();
+
+private:
+    protocol_type ptype_;
+    tm_server::channel channel_;
+    sock_ptr socket_;
+    boost::asio::strand<boost::asio::any_io_executor> strand_;
+    close_handler on_close_ = nullptr;
+
+    lockfree_spsc_queue<queued_frame, spsc_wait::busy_spin> queue_;  // 消费端是 strand 上的发送, 从不等待
+    std::atomic_bool writing_{ false };                                // 发送在进行或已经投递
+    std::atomic_bool closed_{ false };
+
+    // 以下只在 strand 上使用
+    std::vector<int> header_;          // 消息头固定部分, 只填一次
+    // 一次异步写的若干包消息: 帧引用池化缓存, 相邻的尾和下一包的头合成一段, 复用
+    struct piece
+    {
+        const uint8_t *frame;  // nullptr 表示 glue_ 中的一段
+        size_t offset;
+        size_t len;
+    };
+    std::vector<uint8_t> glue_;
+    std::vector<piece> pieces_;
+    std::vector<boost::asio::const_buffer> gather_;
+    std::vector<cortex::tm_msg_ptr> inflight_;  // 写完成前持有帧
+    std::array<uint8_t, 64> read_buf_;
+
+    std::atomic_uint64_t send_count_{ 0 };
+    std::atomic_uint64_t lost_count_{ 0 };
+    std::atomic_uint64_t lag_sum_ns_{ 0 };
+    std::atomic_uint64_t lag_count_{ 0 };
+    std::atomic_uint64_t lag_max_ns_{ 0 };
+    std::atomic_uint64_t copied_bytes_{ 0 };
+    std::atomic_uint64_t write_count_{ 0 };
+    std::atomic_uint64_t syscall_count_{ 0 };
+};
+using tm_session_ptr = std::shared_ptr<tm_session>;
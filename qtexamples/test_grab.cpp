@@ -1,4 +1,5 @@
 
+#include "sti/rate_pacer.h"
 #include "sti/tm_server.h"
 #include "VideoSend/cfte_video_fmt1.hpp"
 #include "ff_grab.hpp"
@@ -42,16 +43,16 @@ int main(int argc, char **argv)
 
     std::ofstream out("www_pcm.bin", std::ios::trunc | std::ios::binary);
     using namespace std::chrono;
+    rate_pacer pacer(100.0);
     for (;;)
     {
+        pacer.wait();
         auto frame = fmt1.make_sub_frame();
         auto ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-        tms.push(0, ms, std::make_shared<std::vector<uint8_t>>(frame));
+        tms.push(0, ms, frame.data(), frame.size());
 
         out.write((char *)frame.data(), frame.size());
         out.flush();
-
-        std::this_thread::sleep_for(10ms);
     }
 
     // std::this_thread::sleep_for(30s);
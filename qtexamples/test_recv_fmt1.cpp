@@ -1,7 +1,9 @@
+#include "VideoRecv/IdleFilter.h"
 #include "sti/cortex_sti_parser.h"
 #include "sti/cortex_tm_client.h"
 #include <boost/endian/conversion.hpp>
 #include <fstream>
+#include <thread>
 
 using namespace boost::endian;
 
@@ -16,60 +18,42 @@ static std::ofstream out[]{
     std::ofstream("www_pcm_3.ts", std::ios::trunc | std::ios::binary),
 };
 
-static bool is_idle_frame(uint8_t *ptr, size_t len)
-{
-    if (len < 8)
-    {
-        return true;
-    }
-    auto numbers = *(uint64_t *)ptr;
-
-    return numbers == 0 || numbers == 0xFADE'FADE'FADE'FADE || numbers == 0xDEFA'DEFA'DEFA'DEFA || numbers == 0xDEAD'DEAD'DEAD'DEAD ||
-           numbers == 0xADDE'ADDE'ADDE'ADDE;
-}
+static IdleFilter idle;
 
 static void output_payload(double time, const std::vector<uint8_t> &payload)
 {
+    static std::vector<char> words[std::size(out)];
     auto ptr = (char *)payload.data();
-    for (auto i = offset; i < payload.size(); i += 2)
+    for (auto i = offset; i + 1 < payload.size(); i += 2)
     {
-        auto channel = (i / 2) % channels;
-        if (bigendian)
-        {
-            out[channel].write(ptr + i, 1);
-            out[channel].write(ptr + i + 1, 1);
-        }
-        else
-        {
-            out[channel].write(ptr + i + 1, 1);
-            out[channel].write(ptr + i, 1);
-        }
+        auto &word = words[(i / 2) % channels];
+        word.push_back(bigendian ? ptr[i] : ptr[i + 1]);
+        word.push_back(bigendian ? ptr[i + 1] : ptr[i]);
     }
-    for (auto &f : out)
+    for (auto i = 0; i < channels; ++i)
     {
-        f.flush();
+        idle.scan((uint8_t *)words[i].data(), words[i].size(), [i](const uint8_t *data, size_t size) {
+            out[i].write((const char *)data, size);
+        });
+        words[i].clear();
     }
 }
 
 int main(int argc, char **argv)
 {
-    cortex::cortex_sti_parser parser(10 * 1024 * 1024);
-    parser.set_tm_msg_callback_fun([](auto &&frame) {
+    auto parser = std::make_shared<cortex::cortex_sti_parser>(10 * 1024 * 1024);
+    parser->set_tm_msg_callback_fun([](auto &&frame) {
         auto ptr = frame->data();
         auto time = (double)load_big_u32(ptr + 12) + (double)load_big_u32(ptr + 16) / 1e3;
         std::vector<uint8_t> payload(frame->begin() + 64, frame->end() - 4);
-        if (!is_idle_frame(payload.data() + offset, payload.size()))
-        {
-            output_payload(time, payload);
-        }
+        output_payload(time, payload);
     });
-    parser.start();
+    parser->start();
 
     cortex::crt_tm_client tmc;
     tmc.set_config({ "127.0.0.1", 3070, 0 });
-    tmc.set_tm_data_callback_fun([&parser](auto &&begin, auto &&end) {
-        parser.push_data(begin, end);
-    });
+    tmc.set_options({ 8 << 20 });
+    tmc.set_tm_parser(parser);
     tmc.set_error_log_callback_fun([](auto &&msg) {
         printf("tmc error: %s\n", msg.c_str());
     });
@@ -77,5 +61,10 @@ int main(int argc, char **argv)
     tmc.start();
 
     for (;;)
-        ;
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        auto pool = cortex::tm_buffer_pool::instance().status();
+        printf("pool: %llu allocations, %llu from heap, %llu in use, %llu KB pooled\n", (unsigned long long)pool.allocations,
+            (unsigned long long)pool.heap_allocations, (unsigned long long)pool.in_use, (unsigned long long)pool.pooled_bytes / 1024);
+    }
 }
@@ -169,7 +169,6 @@ private:
 
 #if SAVE_TS_FILE
         ts_file_.write((char *)buf, len);
-        ts_file_.flush();
 #endif
         return len;
     }
@@ -1,85 +1,389 @@
 ﻿#include "qtexamples/VideoRecv/SplitFrame.h"
-#include <array>
 #include <boost/endian/conversion.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <format>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
-using namespace std;
 using namespace boost::endian;
 
-void split_row_cross()
+// 把按行记录的多路视频 PCM 文件拆成每路一个 ts 文件:
+//   row        每行整行属于一路, 由行里的 sfid 决定: 通道 = (sfid - sfid_first) % channels, sfid < sfid_first 的行丢弃
+//   column     每行从 offset 开始按字(2 字节)轮流分给各路
+//   continuous 每行从 offset 开始均分成 channels 段, 第 i 段属于第 i 路
+enum class DemuxMode
 {
-    std::ifstream in(L"D:/Project/SAC 沈飞/视频问题/测试数据/3路横排10M空前2行", std::ios::binary);
+    Row,
+    Column,
+    Continuous,
+};
 
-    std::vector<std::ofstream> outputs;
-    for (auto i = 0; i < 3; ++i)
+struct DemuxOptions
+{
+    std::string input;
+    std::string prefix{ "output_" };
+    DemuxMode mode{ DemuxMode::Column };
+    size_t row_bytes{ 520 };
+    size_t offset{ 16 };
+    size_t channels{ 3 };
+    bool bigendian{ true };  // 视频数据的字序, 小端时每个字交换字节后输出
+    size_t sfid_pos{ 12 };   // row 模式: 大端 16 位 sfid 在行里的位置
+    size_t sfid_first{ 2 };
+    size_t buffer_mb{ 4 };   // 每路输出缓存, 满了一次写出
+    size_t block_mb{ 0 };    // 0 表示映射整个文件, 否则按这么大的块读
+};
+
+// 只读映射整个文件
+struct MappedFile
+{
+    const uint8_t *data{ nullptr };
+    size_t size{ 0 };
+#ifdef _WIN32
+    HANDLE file{ INVALID_HANDLE_VALUE };
+    HANDLE mapping{ nullptr };
+#endif
+
+    bool open(const std::string &path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER len;
+        if (!GetFileSizeEx(file, &len) || len.QuadPart == 0) return false;
+        size = (size_t)len.QuadPart;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return false;
+        data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+#else
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        size = (size_t)st.st_size;
+        auto ptr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED) return false;
+        ::madvise(ptr, size, MADV_SEQUENTIAL);
+        data = (const uint8_t *)ptr;
+        return true;
+#endif
+    }
+
+    ~MappedFile()
     {
-        outputs.emplace_back(std::format("output_{}.ts", i), std::ios::binary);
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) ::munmap((void *)data, size);
+#endif
     }
-    while (in.good())
+};
+
+// 一路输出: 拆分直接写进缓存, 攒满后一次写出
+class ChannelOutput
+{
+public:
+    ChannelOutput(const std::string &path, size_t capacity)
+        : file_(path, std::ios::binary)
+        , buffer_(capacity)
     {
-        std::string frame(520, 0);
-        in.read(frame.data(), frame.size());
-        auto sfid = load_big_u16((unsigned char *)frame.data() + 12);
-        if (sfid < 2)
+    }
+
+    ~ChannelOutput()
+    {
+        flush();
+    }
+
+    bool good() const
+    {
+        return file_.good();
+    }
+
+    /** 返回至少能写 len 字节的位置, 写完后调用 commit(len) */
+    uint8_t *reserve(size_t len)
+    {
+        if (used_ + len > buffer_.size())
         {
-            continue;
+            flush();
+            if (len > buffer_.size()) buffer_.resize(len);
         }
+        return buffer_.data() + used_;
+    }
 
-        auto channel = (sfid - 2) % 3;
-        auto offset = 8 + 4 + 2;
-        outputs[channel].write(frame.data() + offset, frame.size() - 14);
+    void commit(size_t len)
+    {
+        used_ += len;
+        bytes_ += len;
     }
-}
 
-template <size_t RowBytes, size_t Offset, size_t ChannelCount, bool BigEndian = true>
-void split_col_cross(std::string file, std::string prefix)
+    void flush()
+    {
+        if (used_ == 0) return;
+        file_.write((const char *)buffer_.data(), used_);
+        used_ = 0;
+        writes_++;
+    }
+
+    uint64_t bytes() const
+    {
+        return bytes_;
+    }
+
+    uint64_t writes() const
+    {
+        return writes_;
+    }
+
+private:
+    std::ofstream file_;
+    std::vector<uint8_t> buffer_;
+    size_t used_{ 0 };
+    uint64_t bytes_{ 0 };
+    uint64_t writes_{ 0 };
+};
+
+class Demuxer
 {
-    std::ifstream in(file, std::ios::binary);
-    std::vector<std::ofstream> outputs;
-    for (auto i = 0; i < ChannelCount; ++i)
+public:
+    explicit Demuxer(const DemuxOptions &opts)
+        : opts_(opts)
+        , dst_(opts.channels)
     {
-        outputs.emplace_back(std::format("{}{}.ts", prefix, i), std::ios::binary);
+        for (size_t i = 0; i < opts_.channels; ++i)
+        {
+            outputs_.push_back(std::make_unique<ChannelOutput>(std::format("{}{}.ts", opts_.prefix, i), opts_.buffer_mb << 20));
+        }
     }
-    std::string frame(RowBytes, 0);
-    while (in.good())
+
+    bool good() const
     {
-        in.read(frame.data(), frame.size());
+        return std::all_of(outputs_.begin(), outputs_.end(), [](auto &out) {
+            return out->good();
+        });
+    }
 
-        for (auto i = Offset; i < frame.size(); i += 2)
+    // 处理 rows 个整行
+    void push(const uint8_t *ptr, size_t rows)
+    {
+        for (size_t r = 0; r < rows; ++r, ptr += opts_.row_bytes)
         {
-            auto channel = ((i - Offset) / 2) % ChannelCount;
-            if (BigEndian)
+            switch (opts_.mode)
             {
-                // std::copy_n(frame.data() + i, 2, std::back_inserter(blocks[channel]));
-                outputs[channel].write(frame.data() + i, 1);
-                outputs[channel].write(frame.data() + i + 1, 1);
-            }
-            else
-            {
-                // std::reverse_copy(frame.data() + i, frame.data() + i + 2, std::back_inserter(blocks[channel]));
-                outputs[channel].write(frame.data() + i + 1, 1);
-                outputs[channel].write(frame.data() + i, 1);
+            case DemuxMode::Row:
+                row(ptr);
+                break;
+            case DemuxMode::Column:
+                column(ptr);
+                break;
+            case DemuxMode::Continuous:
+                continuous(ptr);
+                break;
             }
         }
     }
+
+    const std::vector<std::unique_ptr<ChannelOutput>> &outputs() const
+    {
+        return outputs_;
+    }
+
+private:
+    void row(const uint8_t *ptr)
+    {
+        auto sfid = load_big_u16(ptr + opts_.sfid_pos);
+        if (sfid < opts_.sfid_first) return;
+        copy(*outputs_[(sfid - opts_.sfid_first) % opts_.channels], ptr + opts_.offset, opts_.row_bytes - opts_.offset);
+    }
+
+    void column(const uint8_t *ptr)
+    {
+        auto words = (opts_.row_bytes - opts_.offset) / 2;
+        for (size_t c = 0; c < opts_.channels; ++c)
+        {
+            dst_[c] = outputs_[c]->reserve((words + opts_.channels - 1 - c) / opts_.channels * 2);
+        }
+        deinterleave_words(ptr + opts_.offset, words, opts_.channels, opts_.bigendian, dst_.data());
+        for (size_t c = 0; c < opts_.channels; ++c)
+        {
+            outputs_[c]->commit((words + opts_.channels - 1 - c) / opts_.channels * 2);
+        }
+    }
+
+    void continuous(const uint8_t *ptr)
+    {
+        auto bytes = (opts_.row_bytes - opts_.offset) / opts_.channels;
+        for (size_t c = 0; c < opts_.channels; ++c)
+        {
+            copy(*outputs_[c], ptr + opts_.offset + c * bytes, bytes);
+        }
+    }
+
+    void copy(ChannelOutput &out, const uint8_t *src, size_t len)
+    {
+        auto dst = out.reserve(len);
+        if (opts_.bigendian)
+        {
+            memcpy(dst, src, len);
+        }
+        else
+        {
+            auto channel = dst;
+            deinterleave_words(src, len / 2, 1, false, &channel);
+        }
+        out.commit(opts_.bigendian ? len : len / 2 * 2);
+    }
+
+private:
+    DemuxOptions opts_;
+    std::vector<std::unique_ptr<ChannelOutput>> outputs_;
+    std::vector<uint8_t *> dst_;
+};
+
+static void usage()
+{
+    printf("usage: rc2rb <input> [options]\n"
+           "  --mode row|column|continuous   default column\n"
+           "  --row-bytes N      bytes per row, default 520\n"
+           "  --offset N         video data starts at this byte of a row, default 16\n"
+           "  --channels N       default 3\n"
+           "  --little           video words are little endian, swap the bytes of each word\n"
+           "  --sfid-pos N       row mode: big endian 16 bit sfid at this byte, default 12\n"
+           "  --sfid-first N     row mode: first sfid carrying video, default 2\n"
+           "  --prefix P         outputs are P0.ts, P1.ts, ... default output_\n"
+           "  --buffer-mb N      per channel output buffer, default 4\n"
+           "  --block-mb N       read the input in N MB blocks instead of mapping it\n"
+           "examples of layouts seen so far:\n"
+           "  --mode row --row-bytes 520 --offset 14 --channels 3\n"
+           "  --mode column --row-bytes 520 --offset 16 --channels 4\n"
+           "  --mode column --row-bytes 268 --offset 20 --channels 2 --little\n");
 }
 
-int main(int argc, char **argv)
+static bool parse(int argc, char **argv, DemuxOptions &opts)
 {
-    // split_row_cross();
+    std::string_view mode = "column";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        auto value = [&]() -> const char * {
+            return i + 1 < argc ? argv[++i] : "";
+        };
+        if (arg == "--mode")
+            mode = value();
+        else if (arg == "--row-bytes")
+            opts.row_bytes = std::stoul(value());
+        else if (arg == "--offset")
+            opts.offset = std::stoul(value());
+        else if (arg == "--channels")
+            opts.channels = std::stoul(value());
+        else if (arg == "--little")
+            opts.bigendian = false;
+        else if (arg == "--sfid-pos")
+            opts.sfid_pos = std::stoul(value());
+        else if (arg == "--sfid-first")
+            opts.sfid_first = std::stoul(value());
+        else if (arg == "--prefix")
+            opts.prefix = value();
+        else if (arg == "--buffer-mb")
+            opts.buffer_mb = std::stoul(value());
+        else if (arg == "--block-mb")
+            opts.block_mb = std::stoul(value());
+        else if (arg.starts_with("--"))
+            return false;
+        else
+            opts.input = arg;
+    }
+    if (opts.input.empty() || opts.channels == 0 || opts.offset >= opts.row_bytes) return false;
+    if (mode == "row")
+        opts.mode = DemuxMode::Row;
+    else if (mode == "column")
+        opts.mode = DemuxMode::Column;
+    else if (mode == "continuous")
+        opts.mode = DemuxMode::Continuous;
+    else
+        return false;
+    return opts.mode != DemuxMode::Row || opts.sfid_pos + 2 <= opts.row_bytes;
+}
 
-    // ok
-    // split_col_cross<520, 16, 4>("D:/Project/FTS/SAC沈飞/视频问题/2023-05-22 4路视频-520.bin", "output_2");
+int main(int argc, char **argv)
+{
+    DemuxOptions opts;
+    if (!parse(argc, argv, opts))
+    {
+        usage();
+        return 1;
+    }
 
-    // 没画面，有信息
-    split_col_cross<520, 16, 3, true>("D:/Project/FTS/SAC沈飞/视频问题/测试数据/3路视频大端10M", "output_3");
+    Demuxer demuxer(opts);
+    if (!demuxer.good())
+    {
+        printf("cannot create %s*.ts\n", opts.prefix.c_str());
+        return 1;
+    }
 
-    // ok
-    // split_col_cross<268, 20, 2, false>("D:/Project/FTS/SAC沈飞/视频问题2/20231017/20230926.bin 16x268", "output_4");
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t input_bytes = 0;
+    if (opts.block_mb == 0)
+    {
+        MappedFile file;
+        if (!file.open(opts.input))
+        {
+            printf("cannot open %s\n", opts.input.c_str());
+            return 1;
+        }
+        demuxer.push(file.data, file.size / opts.row_bytes);
+        input_bytes = file.size;
+    }
+    else
+    {
+        std::ifstream in(opts.input, std::ios::binary);
+        if (!in)
+        {
+            printf("cannot open %s\n", opts.input.c_str());
+            return 1;
+        }
+        // 块按整行取整, 不会有行跨块
+        std::vector<char> block(std::max<size_t>(1, (opts.block_mb << 20) / opts.row_bytes) * opts.row_bytes);
+        while (in)
+        {
+            in.read(block.data(), block.size());
+            auto got = (size_t)in.gcount();
+            demuxer.push((const uint8_t *)block.data(), got / opts.row_bytes);
+            input_bytes += got;
+        }
+    }
+    for (auto &out : demuxer.outputs())
+    {
+        out->flush();
+    }
+    auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
 
-    // 无画面，无信息
-    // split_col_cross<1032, 520, 2, true>("D:/Project/FTS/SAC沈飞/视频问题2/20231017/2023-09-26SF 8x1032", "output_5");
+    printf("%s: %.1f MB in %.3f s, %.1f MB/s (%s)\n", opts.input.c_str(), input_bytes / 1e6, s, input_bytes / 1e6 / s,
+        opts.block_mb ? std::format("{} MB blocks", opts.block_mb).c_str() : "mapped");
+    for (size_t i = 0; i < demuxer.outputs().size(); ++i)
+    {
+        auto &out = demuxer.outputs()[i];
+        printf("  %s%zu.ts: %.1f MB in %llu writes\n", opts.prefix.c_str(), i, out->bytes() / 1e6, (unsigned long long)out->writes());
+    }
+    if (input_bytes % opts.row_bytes) printf("  last %llu bytes are not a whole row, ignored\n", (unsigned long long)(input_bytes % opts.row_bytes));
+    return 0;
 }
@@ -0,0 +1,106 @@
+#include "qtexamples/sti/tm_parse_service.h"
+#include <atomic>
+#include <boost/endian/conversion.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <thread>
+#include <vector>
+
+// N synthetic CRT links pushed as fast as the parser keeps up, aggregate throughput for 1..W parse workers:
+//   test_parse_service [links] [seconds] [max workers] [pin]
+
+using namespace boost::endian;
+
+// CRT messages with 1 KB frames, packed back to back into one 64 KB receive chunk
+static std::vector<uint8_t> make_chunk(size_t frame_len, size_t chunk_bytes)
+{
+    auto msg_len = 64 + frame_len + 4;
+    std::vector<uint8_t> chunk;
+    for (uint32_t i = 0; chunk.size() + msg_len <= chunk_bytes; ++i)
+    {
+        std::vector<uint8_t> msg(msg_len, 0x5A);
+        store_big_u32(msg.data(), 1234567890);
+        store_big_u32(msg.data() + 4, (uint32_t)msg_len);
+        store_big_u32(msg.data() + 12, 1000 + i);
+        store_big_u32(msg.data() + 16, i % 1000);
+        store_big_u32(msg.data() + 40, (uint32_t)frame_len);
+        store_big_u32(msg.data() + msg_len - 4, (uint32_t)-1234567890);
+        chunk.insert(chunk.end(), msg.begin(), msg.end());
+    }
+    return chunk;
+}
+
+static void run(int links, size_t workers, double seconds, bool pin)
+{
+    cortex::tm_parse_service service(workers, pin);
+    std::atomic_uint64_t frame_bytes = 0;
+    for (int i = 0; i < links; ++i)
+    {
+        service.add_link({ cortex::tm_link_type::crt, 0, 16 << 20 }, [&frame_bytes](auto &&, auto &&frames) {
+            for (auto &f : frames)
+            {
+                frame_bytes.fetch_add(f.len, std::memory_order_relaxed);
+            }
+        });
+    }
+    service.start();
+
+    auto chunk = make_chunk(1024, 64 << 10);
+    std::atomic_bool stop = false;
+    std::vector<std::thread> producers;
+    for (int i = 0; i < links; ++i)
+    {
+        producers.emplace_back([&, i] {
+            // keep the ring at most half full so nothing is dropped, the rate is set by the parser
+            while (!stop)
+            {
+                auto st = service.get_link_status(i);
+                if (st.backlog > st.capacity / 2)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                service.push_data(i, chunk.data(), chunk.size());
+            }
+        });
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &t : producers)
+    {
+        t.join();
+    }
+    auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    uint64_t messages = 0, lost = 0, errors = 0;
+    double latency = 0, latency_max = 0;
+    for (int i = 0; i < links; ++i)
+    {
+        auto st = service.get_link_status(i);
+        messages += st.messages;
+        lost += st.lost;
+        errors += st.errors;
+        latency += st.latency_avg_us / links;
+        latency_max = std::max(latency_max, st.latency_max_us);
+    }
+    service.stop();
+    fmt::print("{} links {:>2} workers: {:8.0f} msgs/s {:8.1f} MB/s frames  latency avg {:8.1f} us max {:9.1f} us  lost {} errors {}\n",
+        links, service.worker_count(), messages / s, frame_bytes / s / 1e6, latency, latency_max, lost, errors);
+}
+
+int main(int argc, char **argv)
+{
+    auto links = argc > 1 ? atoi(argv[1]) : 8;
+    auto seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    auto max_workers = argc > 3 ? (size_t)atoi(argv[3]) : (size_t)std::max(1u, std::thread::hardware_concurrency());
+    auto pin = argc > 4 && atoi(argv[4]) != 0;
+    fmt::print("{} hardware threads\n", std::thread::hardware_concurrency());
+    for (size_t workers = 1; workers <= max_workers; workers *= 2)
+    {
+        run(links, workers, seconds, pin);
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "qtexamples/sti/rpc_server.h"
+#include <atomic>
+#include <boost/endian/conversion.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <thread>
+#include <vector>
+
+// N loopback clients each keep a window of requests in flight and wait for the acknowledgements, aggregate request rate:
+//   test_rpc_server [clients] [seconds] [window] [payload bytes] [port]
+
+using namespace boost::endian;
+using boost::asio::ip::tcp;
+
+// window requests packed back to back, sequence numbers start at seq
+static void fill_requests(std::vector<uint8_t> &buf, size_t window, size_t payload, uint32_t seq)
+{
+    auto msg_len = 20 + (payload + 3) / 4 * 4 + 4;
+    buf.assign(window * msg_len, 0x5A);
+    for (size_t i = 0; i < window; ++i)
+    {
+        auto msg = buf.data() + i * msg_len;
+        store_big_u32(msg, 1234567890);
+        store_big_u32(msg + 4, (uint32_t)msg_len);
+        store_big_u32(msg + 8, seq + (uint32_t)i);
+        store_big_u32(msg + 12, 1);
+        store_big_u32(msg + 16, (uint32_t)payload);
+        store_big_u32(msg + msg_len - 4, (uint32_t)-1234567890);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    auto clients = argc > 1 ? atoi(argv[1]) : 8;
+    auto seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    auto window = argc > 3 ? (size_t)atoi(argv[3]) : 32;
+    auto payload = argc > 4 ? (size_t)atoi(argv[4]) : 32;
+    auto port = (unsigned short)(argc > 5 ? atoi(argv[5]) : 9901);
+
+    rpc_server server;
+    std::atomic_uint64_t handled = 0;
+    server.bind_xfer_handler([&handled](int, data_ptr) {
+        handled.fetch_add(1, std::memory_order_relaxed);
+    });
+    if (!server.bind(port)) return 1;
+    server.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::atomic_bool stop = false;
+    std::atomic_uint64_t acked = 0, bad = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i)
+    {
+        threads.emplace_back([&] {
+            boost::asio::io_context io;
+            tcp::socket socket(io);
+            socket.connect({ boost::asio::ip::make_address("127.0.0.1"), port });
+            socket.set_option(tcp::no_delay(true));
+            std::vector<uint8_t> requests, acks(window * 20);
+            uint32_t seq = 0;
+            while (!stop)
+            {
+                fill_requests(requests, window, payload, seq);
+                boost::asio::write(socket, boost::asio::buffer(requests));
+                boost::asio::read(socket, boost::asio::buffer(acks));
+                // acknowledgements come back in request order with the sequence number echoed
+                for (size_t k = 0; k < window; ++k)
+                {
+                    if (load_big_u32(acks.data() + k * 20 + 8) != seq + k || load_big_u32(acks.data() + k * 20 + 12) != 0) bad++;
+                }
+                seq += (uint32_t)window;
+                acked += window;
+            }
+        });
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    uint64_t requests = 0, writes = 0;
+    for (auto &st : server.get_client_status())
+    {
+        requests += st.requests;
+        writes += st.writes;
+    }
+    stop = true;
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    fmt::print("{} clients window {:>3} payload {} B: {:9.0f} req/s  {:9.0f} handled/s  {:5.1f} acks/write  bad {}\n", clients, window, payload,
+        acked / s, handled / s, writes ? (double)requests / writes : 0.0, bad.load());
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "qtexamples/VideoRecv/sti_reader.h"
+#include "qtexamples/sti/tm_server.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <thread>
+#include <vector>
+
+// tm_server feeds one channel both to TCP subscribers and to a shared memory ring, N sti_reader per transport on this host
+// measure push-to-delivery latency and throughput of each:
+//   test_shm_ring [readers] [frames/s, 0 = as fast as possible] [seconds] [frame bytes] [ring KB] [port]
+// a small ring with frames/s 0 laps the shm readers: they must count lost frames and never see a torn one
+
+struct reader_result
+{
+    std::vector<double> latency_us;
+    uint64_t messages = 0;
+    uint64_t lost = 0;
+    uint64_t bad = 0;
+};
+
+static double percentile(std::vector<double> &v, double p)
+{
+    if (v.empty()) return 0;
+    auto k = std::min(v.size() - 1, size_t(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+int main(int argc, char **argv)
+{
+    auto readers = argc > 1 ? atoi(argv[1]) : 2;
+    auto rate = argc > 2 ? atof(argv[2]) : 20000;
+    auto seconds = argc > 3 ? atof(argv[3]) : 2.0;
+    auto frame_len = argc > 4 ? atoi(argv[4]) : 1024;
+    auto ring_kb = argc > 5 ? atoi(argv[5]) : 64 << 10;
+    auto port = (uint16_t)(argc > 6 ? atoi(argv[6]) : 9904);
+
+    tm_server server;
+    server.register_channel({ 0, 32, frame_len, 1 });
+    if (!server.add_shm_target(0, "test_shm_ring", (size_t)ring_kb << 10)) return 1;
+    server.bind(port);
+    server.start();
+
+    std::atomic_bool stop = false;
+    std::vector<reader_result> results(readers * 2);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers * 2; ++i)
+    {
+        threads.emplace_back([&, i] {
+            boost::asio::io_context io;
+            sti_reader r(io, i < readers ? "shm:test_shm_ring" : "127.0.0.1", port);
+            auto &result = results[i];
+            r.run(0, 0, [&](std::span<const uint8_t> msg) {
+                if (stop) return false;
+                if (msg.size() != 64 + (size_t)frame_len + 4 || boost::endian::load_big_u32(msg.data()) != cortex::STI_HEAD ||
+                    boost::endian::load_big_u32(msg.data() + msg.size() - 4) != cortex::STI_TAIL || msg[msg.size() - 5] != 0x5A)
+                {
+                    result.bad++;
+                }
+                else
+                {
+                    // the frame starts with the steady clock at push
+                    int64_t pushed;
+                    memcpy(&pushed, msg.data() + 64, sizeof(pushed));
+                    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+                    result.latency_us.push_back((now - pushed) / 1e3);
+                }
+                return true;
+            });
+            result.messages = r.status().messages;
+            result.lost = r.status().lost;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    std::vector<uint8_t> frame(frame_len, 0x5A);
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t pushed = 0;
+    while (true)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration<double>(now - t0).count();
+        if (elapsed >= seconds) break;
+        for (auto target = rate > 0 ? uint64_t(elapsed * rate) : pushed + 64; pushed < target; ++pushed)
+        {
+            auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+            memcpy(frame.data(), &stamp, sizeof(stamp));
+            server.push(0, 1700000000000ull + pushed, frame.data(), frame.size());
+        }
+        if (rate > 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    stop = true;
+    // one more frame so that every reader returns from its wait and sees stop
+    server.push(0, 0, frame.data(), frame.size());
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    fmt::print("{} frames of {} B pushed in {:.2f} s ({:.0f}/s)\n", pushed, frame_len, s, pushed / s);
+    for (int i = 0; i < readers * 2; ++i)
+    {
+        auto &r = results[i];
+        fmt::print("{} reader {}: {:8} msgs {:7.1f} MB/s  lost {:6} bad {}  latency p50 {:7.1f} us p99 {:8.1f} us max {:9.1f} us\n", i < readers ? "shm" : "tcp",
+            i % readers, r.messages, r.messages * (frame_len + 68) / s / 1e6, r.lost, r.bad, percentile(r.latency_us, 0.5), percentile(r.latency_us, 0.99),
+            r.latency_us.empty() ? 0.0 : *std::max_element(r.latency_us.begin(), r.latency_us.end()));
+    }
+    for (auto &st : server.get_target_status())
+    {
+        fmt::print("target {}: {} sent {} errors\n", st.target, st.sent, st.errors);
+    }
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "qtexamples/sti/lockfree_spsc_queue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// compares the lockfree_spsc_queue wait strategies:
+//   stream  - byte stream in 1 KB chunks like cortex_sti_parser, unthrottled
+//   latency - message descriptors at a fixed rate like the telemetry simulator, push -> pop latency percentiles
+
+using clock_type = std::chrono::steady_clock;
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+template <class Wait>
+static void run_stream(std::string_view name, size_t chunk, double seconds)
+{
+    lockfree_spsc_queue<uint8_t, Wait> q(16 << 20);
+    std::vector<uint8_t> src(chunk, 0x5A);
+    std::atomic<bool> done{ false };
+    uint64_t received = 0;
+
+    std::thread consumer([&] {
+        while (true)
+        {
+            auto span = q.read_span();
+            if (span.empty()) break;
+            received += span.size();
+            q.consume(span.size());
+        }
+    });
+
+    auto t0 = clock_type::now();
+    while (clock_type::now() - t0 < std::chrono::duration<double>(seconds))
+    {
+        for (int i = 0; i < 64; ++i)
+        {
+            auto span = q.write_span(chunk);
+            if (span.empty())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            // the span stops at the end of the ring, the rest of the chunk goes to the start next time
+            memcpy(span.data(), src.data(), span.size());
+            q.commit(span.size());
+        }
+    }
+    while (q.used_size() > 0)
+    {
+        std::this_thread::yield();
+    }
+    auto s = std::chrono::duration<double>(clock_type::now() - t0).count();
+    q.quit();
+    consumer.join();
+    fmt::print("{:<12} stream  chunk {:>6} B: {:8.2f} GB/s {:10.0f} chunks/s\n", name, chunk, received / s / 1e9, received / chunk / s);
+}
+
+template <class Wait>
+static void run_latency(std::string_view name, double rate, double seconds)
+{
+    struct sample
+    {
+        int64_t sent_ns;
+        uint32_t len;
+    };
+    lockfree_spsc_queue<sample, Wait> q(4096);
+    auto count = (size_t)(rate * seconds);
+    std::vector<int64_t> latency;
+    latency.reserve(count);
+    std::atomic<size_t> received{ 0 };
+
+    std::thread consumer([&] {
+        sample s;
+        while (q.pop(&s, 1) == 1)
+        {
+            latency.push_back(now_ns() - s.sent_ns);
+            received.fetch_add(1, std::memory_order_release);
+        }
+    });
+
+    auto period = (int64_t)(1e9 / rate);
+    auto next = now_ns();
+    for (size_t i = 0; i < count; ++i)
+    {
+        // sleep while far from the deadline, spin for the last stretch so the send time stays precise
+        while (next - now_ns() > 200'000)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        while (now_ns() < next)
+        {
+        }
+        q.push({ now_ns(), 1092 });
+        next += period;
+    }
+    // only the counter is shared, the vector is read after the join
+    auto deadline = now_ns() + 1'000'000'000;
+    while (received.load(std::memory_order_acquire) < count && now_ns() < deadline)
+    {
+        std::this_thread::yield();
+    }
+    q.quit();
+    consumer.join();
+
+    std::sort(latency.begin(), latency.end());
+    auto pct = [&](double p) {
+        return latency.empty() ? 0.0 : latency[std::min(latency.size() - 1, (size_t)(p * latency.size()))] / 1e3;
+    };
+    fmt::print("{:<12} latency {:>8.0f} msg/s: p50 {:8.1f} us  p99 {:8.1f} us  max {:9.1f} us  ({} msgs)\n", name, rate, pct(0.5),
+        pct(0.99), latency.empty() ? 0.0 : latency.back() / 1e3, latency.size());
+}
+
+template <class Wait>
+static void run_all(std::string_view name, double seconds)
+{
+    for (auto chunk : { 1092, 64 * 1024 })
+    {
+        run_stream<Wait>(name, chunk, seconds);
+    }
+    // CRT telemetry rates: 512 B frames at 10 ms, at 1 ms, and a fast HDR link
+    for (auto rate : { 100.0, 1000.0, 100000.0 })
+    {
+        run_latency<Wait>(name, rate, std::max(seconds, 200 / rate));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    auto seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    auto only = argc > 2 ? std::string_view(argv[2]) : std::string_view();
+    fmt::print("{} hardware threads\n", std::thread::hardware_concurrency());
+    if (only.empty() || only == "blocking") run_all<spsc_wait::blocking>("blocking", seconds);
+    if (only.empty() || only == "spin_park") run_all<spsc_wait::spin_park<>>("spin_park", seconds);
+    if (only.empty() || only == "spin_yield") run_all<spsc_wait::spin_yield<>>("spin_yield", seconds);
+    if (only.empty() || only == "busy_spin") run_all<spsc_wait::busy_spin>("busy_spin", seconds);
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "qtexamples/sti/cortex_sti_parser.h"
+#include "qtexamples/sti/sti_framer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// STI parse throughput, the target is 1.2 Gbps of CRT telemetry:
+//   framer - parse_sti_frames over a stream already in memory, one thread; a clean message only costs its header and tail
+//   view   - cortex_sti_parser fed through receive() in chunks, messages handed out in place
+//   msg    - the same with the tm_msg callback, every message copied to a pooled buffer
+//   test_sti_parser [seconds] [frame bytes] [chunk bytes] [junk every N messages, 0 = clean]
+
+using clock_type = std::chrono::steady_clock;
+
+struct sti_stream
+{
+    std::vector<uint8_t> bytes;
+    size_t messages = 0;
+};
+
+// 64 B header + frame + 4 B tail per message, a few junk bytes now and then make the parser resync
+static sti_stream make_stream(size_t total, int frame_len, int junk_every)
+{
+    sti_stream s;
+    auto msg_len = 64 + frame_len + 4;
+    std::vector<uint8_t> msg(msg_len, 0x5A);
+    boost::endian::store_big_u32(msg.data(), cortex::STI_HEAD);
+    boost::endian::store_big_u32(msg.data() + 4, msg_len);
+    boost::endian::store_big_u32(msg.data() + msg_len - 4, cortex::STI_TAIL);
+    while (s.bytes.size() + msg_len <= total)
+    {
+        boost::endian::store_big_u32(msg.data() + 20, (uint32_t)s.messages);
+        s.bytes.insert(s.bytes.end(), msg.begin(), msg.end());
+        if (junk_every > 0 && ++s.messages % junk_every == 0)
+        {
+            s.bytes.insert(s.bytes.end(), { 0x49, 0x96, 0x02, 0x00, 0x11 });
+        }
+        else if (junk_every <= 0)
+        {
+            s.messages++;
+        }
+    }
+    return s;
+}
+
+static void run_framer(const sti_stream &s, double seconds)
+{
+    uint64_t bytes = 0;
+    uint64_t messages = 0;
+    uint64_t errors = 0;
+    auto t0 = clock_type::now();
+    while (clock_type::now() - t0 < std::chrono::duration<double>(seconds))
+    {
+        size_t found = 0;
+        cortex::parse_sti_frames(
+            s.bytes.data(), s.bytes.size(), [&found](const uint8_t *, size_t) { found++; }, errors);
+        if (found != s.messages) fmt::print("framer: {} of {} messages\n", found, s.messages);
+        messages += found;
+        bytes += s.bytes.size();
+    }
+    auto sec = std::chrono::duration<double>(clock_type::now() - t0).count();
+    fmt::print("framer            : {:8.2f} Gbps {:10.0f} msgs/s  {} errors\n", bytes * 8 / sec / 1e9, messages / sec, errors);
+}
+
+static void run_parser(std::string_view mode, const sti_stream &s, size_t chunk, double seconds)
+{
+    cortex::cortex_sti_parser parser(16 << 20);
+    std::atomic<uint64_t> delivered{ 0 };
+    if (mode == "view")
+    {
+        parser.set_tm_msg_view_callback_fun([&](const uint8_t *, size_t) { delivered++; });
+    }
+    else
+    {
+        parser.set_tm_msg_callback_fun([&](const cortex::tm_msg_ptr &) { delivered++; });
+    }
+    parser.start();
+
+    uint64_t bytes = 0;
+    uint64_t expected = 0;
+    auto t0 = clock_type::now();
+    while (clock_type::now() - t0 < std::chrono::duration<double>(seconds))
+    {
+        // the whole stream in chunk sized reads, like a socket receive loop
+        for (size_t pos = 0; pos < s.bytes.size();)
+        {
+            pos += parser.receive([&](uint8_t *data, size_t len) {
+                auto n = std::min({ len, chunk, s.bytes.size() - pos });
+                memcpy(data, s.bytes.data() + pos, n);
+                return (int)n;
+            });
+        }
+        bytes += s.bytes.size();
+        expected += s.messages;
+    }
+    // wait for the parser thread to drain what is still queued
+    auto deadline = clock_type::now() + std::chrono::seconds(5);
+    while (delivered < expected && clock_type::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+    auto sec = std::chrono::duration<double>(clock_type::now() - t0).count();
+    auto st = parser.get_buffer_status();
+    parser.stop();
+    fmt::print("{:<6} chunk {:>6} : {:8.2f} Gbps {:10.0f} msgs/s  {} of {} msgs  {} errors  {} lost\n", mode, chunk, bytes * 8 / sec / 1e9,
+        delivered / sec, delivered.load(), expected, st.errors, st.lost);
+}
+
+int main(int argc, char **argv)
+{
+    auto seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    auto frame_len = argc > 2 ? atoi(argv[2]) : 1024;
+    auto chunk = (size_t)(argc > 3 ? atoi(argv[3]) : 64 << 10);
+    auto junk_every = argc > 4 ? atoi(argv[4]) : 0;
+
+    auto stream = make_stream(64 << 20, frame_len, junk_every);
+    fmt::print("{} messages of {} B in a {} MB stream, junk every {} messages\n", stream.messages, 64 + frame_len + 4, stream.bytes.size() >> 20,
+        junk_every);
+    run_framer(stream, seconds);
+    for (auto mode : { "view", "msg" })
+    {
+        run_parser(mode, stream, chunk, seconds);
+    }
+    return 0;
+}
@@ -1,12 +1,61 @@
 #include "qtexamples/VideoRecv/sti_reader.h"
+#include "qtexamples/VideoRecv/sti_reader_coro.h"
+#include <cstdlib>
 #include <fmt/format.h>
 
+// N connections on one io_context thread, prints the aggregate throughput once a second
+static void run_coro(const char *ip, uint16_t port, int channel, int connections)
+{
+    boost::asio::io_context io;
+    sti_reader_coro r(io);
+    for (auto i = 0; i < connections; ++i)
+    {
+        r.subscribe({ ip, port, sti_reader_coro::protocol::CRT, channel }, [](size_t, std::span<const uint8_t>) {
+        });
+    }
+
+    boost::asio::steady_timer timer(io);
+    auto last = r.total();
+    std::function<void()> report = [&] {
+        timer.expires_after(std::chrono::seconds(1));
+        timer.async_wait([&](auto &&ec) {
+            if (ec) return;
+            auto now = r.total();
+            fmt::println("{} connections: {} msgs/s, {:.1f} MB/s, {} resyncs, {} reconnects", connections, now.messages - last.messages,
+                (now.bytes - last.bytes) / 1e6, now.resyncs, now.reconnects);
+            last = now;
+            report();
+        });
+    };
+    report();
+    io.run();
+}
+
 int main(int argc, char **argv)
 {
+    auto ip = argc > 1 ? argv[1] : "127.0.0.1";
+    uint16_t port = argc > 2 ? std::atoi(argv[2]) : 3070;
+    int channel = argc > 3 ? std::atoi(argv[3]) : 0;
+    int connections = argc > 4 ? std::atoi(argv[4]) : 0;
+    if (connections > 0)
+    {
+        run_coro(ip, port, channel, connections);
+        return 0;
+    }
+
     boost::asio::io_context io;
-    sti_reader r(io, "127.0.0.1", 3070);
-    r.run(0, 0, [](auto &&msg) {
-        fmt::println("==== {:02X}", fmt::join(msg, " "));
+    sti_reader r(io, ip, port);
+    auto last = std::chrono::steady_clock::now();
+    r.run(channel, 0, [&r, &last](std::span<const uint8_t> msg) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last >= std::chrono::seconds(1))
+        {
+            auto s = r.status();
+            fmt::println("{:.0f} msgs/s, {} msgs, {} MB, copied {:.2f} B/msg, {} resyncs", s.msgs_per_sec, s.messages, s.bytes >> 20,
+                s.messages ? (double)s.copied / s.messages : 0.0, s.resyncs);
+            if (!msg.empty()) fmt::println("==== {:02X}", fmt::join(msg.first(std::min<size_t>(msg.size(), 32)), " "));
+            last = now;
+        }
         return true;
     });
     io.run();
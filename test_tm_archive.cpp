@@ -0,0 +1,128 @@
+#include "qtexamples/VideoRecv/TmArchive.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <random>
+#include <vector>
+
+// writes frames with TmArchiveWriter, then reads random time windows back with TmArchiveReader and checks every frame:
+//   test_tm_archive [frames] [frame bytes] [window ms] [windows] [path without extension]
+// frame i is stamped T0 + i * 1 ms + (i % 7) us, carries i in its first 8 bytes and sfid i % 32
+
+constexpr int64_t T0 = 1'700'000'000'000'000;
+
+static int64_t frame_time(uint64_t i)
+{
+    return T0 + (int64_t)i * 1000 + (int64_t)(i % 7);
+}
+
+// frames whose time falls in [begin, end), times are strictly increasing
+static uint64_t first_at(int64_t t, uint64_t frames)
+{
+    uint64_t lo = 0, hi = frames;
+    while (lo < hi)
+    {
+        auto mid = (lo + hi) / 2;
+        if (frame_time(mid) < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int main(int argc, char **argv)
+{
+    auto frames = (uint64_t)(argc > 1 ? atoll(argv[1]) : 200000);
+    auto frame_len = (size_t)(argc > 2 ? atoi(argv[2]) : 1024);
+    auto window_ms = argc > 3 ? atoi(argv[3]) : 1000;
+    auto windows = argc > 4 ? atoi(argv[4]) : 1000;
+    std::string path = argc > 5 ? argv[5] : "test_tm_archive";
+    if (frame_len < 8) frame_len = 8;
+
+    auto t0 = std::chrono::steady_clock::now();
+    TmArchiveWriter::Status written;
+    {
+        RecordOptions opts;
+        opts.path = path;
+        TmArchiveWriter writer(opts);
+        std::vector<uint8_t> frame(frame_len);
+        for (uint64_t i = 0; i < frames; ++i)
+        {
+            memcpy(frame.data(), &i, sizeof(i));
+            memset(frame.data() + 8, (uint8_t)i, frame_len - 8);
+            writer.setChannelOffset(0, i * 100);
+            writer.write(frame_time(i), (uint16_t)(i % 32), frame.data(), frame.size());
+        }
+        // the last chunk is only handed over by flush (or the destructor), count it too
+        writer.flush();
+        written = writer.status();
+        fmt::print("wrote {} frames of {} B in {} chunks, {} rejected, {:.2f} s\n", written.frames, frame_len, written.chunks, written.rejected,
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+
+    TmArchiveReader reader;
+    if (!reader.open(path)) return 1;
+    fmt::print("index {} chunks, {} .. {} us\n", reader.index().size(), reader.beginUs() - T0, reader.endUs() - T0);
+    if (written.frames != frames || written.rejected != 0 || written.chunks != reader.index().size())
+    {
+        fmt::print("writer reports {} frames in {} chunks, expected {} frames, index holds {} chunks\n", written.frames, written.chunks, frames,
+            reader.index().size());
+        return 1;
+    }
+
+    std::mt19937_64 rng(1);
+    std::uniform_int_distribution<int64_t> start(T0 - 1000, frame_time(frames) + 1000);
+    uint64_t checked = 0;
+    int bad = 0;
+    double cold_us = 0;
+    double warm_us = 0;
+    for (int w = 0; w < windows; ++w)
+    {
+        auto begin = start(rng);
+        auto end = begin + window_ms * 1000LL;
+        auto expect = first_at(begin, frames);
+        auto last = first_at(end, frames);
+
+        // timed passes: the lookup and the walk over the records alone, the first one also faults in the mapped pages
+        size_t seen = 0;
+        for (auto pass : { 0, 1 })
+        {
+            auto r0 = std::chrono::steady_clock::now();
+            seen = reader.read(begin, end, [](const TmArchiveReader::Frame &) {});
+            (pass ? warm_us : cold_us) += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - r0).count();
+        }
+
+        auto next = expect;
+        auto count = reader.read(begin, end, [&](const TmArchiveReader::Frame &f) {
+            uint64_t i;
+            memcpy(&i, f.data.data(), sizeof(i));
+            if (i != next || f.timeUs != frame_time(i) || f.sfid != i % 32 || f.data.size() != frame_len ||
+                f.data[frame_len - 1] != (uint8_t)i)
+            {
+                if (bad++ < 10) fmt::print("window {}: frame {} expected, got {} at {}\n", w, next, i, f.timeUs - T0);
+            }
+            next++;
+        });
+        if (count != last - expect || seen != count)
+        {
+            if (bad++ < 10) fmt::print("window {}: {} frames, expected {}\n", w, count, last - expect);
+        }
+        // the ts offset must not be past the first frame of the window, or decoding from it misses that frame
+        if (expect < frames && reader.tsOffset(0, begin) > expect * 100)
+        {
+            if (bad++ < 10) fmt::print("window {}: ts offset {} past frame {}\n", w, reader.tsOffset(0, begin), expect);
+        }
+        checked += count;
+    }
+    fmt::print("{} windows of {} ms: {} frames checked, {} errors, {:.1f} us per window on first read, {:.1f} us repeated\n", windows, window_ms,
+        checked, bad, cold_us / windows, warm_us / windows);
+
+    reader.close();
+    std::filesystem::remove(path + ".tma");
+    std::filesystem::remove(path + ".tmi");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+#include "qtexamples/sti/cortex_tm_client.h"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/endian/conversion.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <thread>
+#include <vector>
+
+// A loopback CRT source writes as fast as the client reads, once through the data callback + push_data copy
+// and once reading straight into the parser ring, with default and enlarged SO_RCVBUF:
+//   test_tm_client [seconds] [rcvbuf MB] [port]
+
+using namespace boost::endian;
+using boost::asio::ip::tcp;
+
+// CRT messages with 1 KB frames, packed back to back into one 1 MB send chunk
+static std::vector<uint8_t> make_chunk(size_t frame_len, size_t chunk_bytes)
+{
+    auto msg_len = 64 + frame_len + 4;
+    std::vector<uint8_t> chunk;
+    for (uint32_t i = 0; chunk.size() + msg_len <= chunk_bytes; ++i)
+    {
+        std::vector<uint8_t> msg(msg_len, 0x5A);
+        store_big_u32(msg.data(), 1234567890);
+        store_big_u32(msg.data() + 4, (uint32_t)msg_len);
+        store_big_u32(msg.data() + 40, (uint32_t)frame_len);
+        store_big_u32(msg.data() + msg_len - 4, (uint32_t)-1234567890);
+        chunk.insert(chunk.end(), msg.begin(), msg.end());
+    }
+    return chunk;
+}
+
+static void run(bool direct, int rcvbuf, double seconds, unsigned short port)
+{
+    boost::asio::io_context io;
+    tcp::acceptor acceptor(io, { tcp::v4(), port });
+    std::thread source([&acceptor] {
+        tcp::socket socket(acceptor.get_executor());
+        acceptor.accept(socket);
+        std::vector<uint8_t> request(64);
+        boost::asio::read(socket, boost::asio::buffer(request));
+        auto chunk = make_chunk(1024, 1 << 20);
+        boost::system::error_code ec;
+        while (!ec)
+        {
+            boost::asio::write(socket, boost::asio::buffer(chunk), ec);
+        }
+    });
+
+    auto parser = std::make_shared<cortex::cortex_sti_parser>(16 << 20);
+    std::atomic_uint64_t msg_bytes = 0;
+    parser->set_tm_msg_view_callback_fun([&msg_bytes](const uint8_t *, size_t len) {
+        msg_bytes.fetch_add(len, std::memory_order_relaxed);
+    });
+    parser->start();
+
+    cortex::crt_tm_client client;
+    cortex::cortex_tm_config config{};
+    config.ip = "127.0.0.1";
+    config.port = port;
+    client.set_config(config);
+    client.set_options({ rcvbuf });
+    if (direct)
+    {
+        client.set_tm_parser(parser);
+    }
+    else
+    {
+        client.set_tm_data_callback_fun([&parser](auto &&begin, auto &&end) {
+            parser->push_data(begin, end);
+        });
+    }
+    client.start();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto t0 = std::chrono::steady_clock::now();
+    auto bytes0 = msg_bytes.load();
+    auto msgs0 = parser->get_buffer_status().messages;
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    auto bytes = msg_bytes - bytes0;
+    auto sock = client.get_socket_status();
+    auto buf = parser->get_buffer_status();
+    client.stop();
+    parser->stop();
+    source.join();
+
+    fmt::print("{:>6} rcvbuf {:>5} KB: {:7.0f} MB/s {:6.2f} Gbps {:8.0f} msgs/s  lost {} errors {}  kernel queued {} KB drops {} rcv_space {} KB\n",
+        direct ? "direct" : "copy", sock.recv_buffer / 1024, bytes / s / 1e6, bytes * 8 / s / 1e9, (buf.messages - msgs0) / s, buf.lost, buf.errors,
+        sock.queued / 1024, sock.drops, sock.rcv_space / 1024);
+}
+
+int main(int argc, char **argv)
+{
+    auto seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    auto rcvbuf = argc > 2 ? atoi(argv[2]) << 20 : 8 << 20;
+    auto port = (unsigned short)(argc > 3 ? atoi(argv[3]) : 9902);
+    for (auto size : { 0, rcvbuf })
+    {
+        run(false, size, seconds, port++);
+        run(true, size, seconds, port++);
+    }
+    return 0;
+}
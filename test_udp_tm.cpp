@@ -0,0 +1,80 @@
+#include "qtexamples/sti/cortex_udp_client.h"
+#include "qtexamples/sti/tm_server.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// tm_server multicasts one channel, N udp_tm_client receivers on this host share the flow:
+//   test_udp_tm [receivers] [frames/s] [seconds] [frame bytes] [group] [port]
+// group 127.0.0.1 tests plain unicast with a single receiver.
+
+int main(int argc, char **argv)
+{
+    auto receivers = argc > 1 ? atoi(argv[1]) : 4;
+    auto rate = argc > 2 ? atof(argv[2]) : 20000;
+    auto seconds = argc > 3 ? atof(argv[3]) : 2.0;
+    auto frame_len = argc > 4 ? atoi(argv[4]) : 1024;
+    std::string group = argc > 5 ? argv[5] : "239.255.0.1";
+    auto port = (uint16_t)(argc > 6 ? atoi(argv[6]) : 9903);
+
+    std::vector<std::unique_ptr<cortex::udp_tm_client>> clients;
+    std::vector<std::unique_ptr<std::atomic_uint64_t>> bytes;
+    for (int i = 0; i < receivers; ++i)
+    {
+        auto client = std::make_unique<cortex::udp_tm_client>();
+        auto counter = std::make_unique<std::atomic_uint64_t>(0);
+        cortex::udp_tm_config config{};
+        config.address = group;
+        config.port = port;
+        client->set_config(config);
+        client->set_tm_msg_view_callback_fun([c = counter.get()](const uint8_t *, size_t len) {
+            c->fetch_add(len, std::memory_order_relaxed);
+        });
+        if (!client->start()) return 1;
+        clients.push_back(std::move(client));
+        bytes.push_back(std::move(counter));
+    }
+
+    tm_server server;
+    server.register_channel({ 0, 32, frame_len, 1 });
+    if (!server.add_udp_target(0, group, port)) return 1;
+
+    std::vector<uint8_t> frame(frame_len, 0x5A);
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t pushed = 0;
+    while (true)
+    {
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (elapsed >= seconds) break;
+        for (auto target = uint64_t(elapsed * rate); pushed < target; ++pushed)
+        {
+            server.push(0, 1700000000000ull + pushed, frame.data(), frame.size());
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    for (auto &st : server.get_target_status())
+    {
+        fmt::print("sender {} channel {}: {} sent ({:.0f}/s, {:.1f} MB/s), {} errors\n", st.target, st.channel, st.sent, st.sent / s,
+            st.sent * (frame_len + 68) / s / 1e6, st.errors);
+    }
+    for (int i = 0; i < receivers; ++i)
+    {
+        auto st = clients[i]->get_status();
+        clients[i]->stop();
+        for (auto &src : st.sources)
+        {
+            fmt::print("receiver {} from {}: {} msgs {:5.2f}% lost, {} reordered, {} duplicates  {:.1f} datagrams/call  {} errors {} drops  rcvbuf {} KB\n",
+                i, src.source, src.messages, pushed ? 100.0 * src.lost / pushed : 0.0, src.reordered, src.duplicates,
+                st.batches ? (double)st.datagrams / st.batches : 0.0, st.errors, st.drops, st.recv_buffer / 1024);
+        }
+        if (st.sources.empty()) fmt::print("receiver {}: nothing received\n", i);
+    }
+    return 0;
+}
@@ -1,5 +1,8 @@
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <filesystem>
 #include <fmt/format.h>
 #include <fmt/std.h>
@@ -7,8 +10,19 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <string_view>
+#include <thread>
 #include <vector>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
 struct Range
 {
@@ -34,71 +48,289 @@ struct PcmFileConfig
     std::map<size_t, std::vector<Range>> sfid2ranges;
 };
 
+// PcmFileConfig ɵĳȡƻ:  sfid ֱ±, ͬһ sfid βӵϲһο,
+// ÿοڸø֡ƫƺÿֽ֡Ԥ, ȡʱֻʣ memcpy
+struct PcmExtractPlan
+{
+    struct Copy
+    {
+        uint32_t src;  // ڸ֡ƫ
+        uint32_t dst;  // ڸø֡ƫ
+        uint32_t len;
+    };
+    struct Entry
+    {
+        uint32_t first{ 0 };  // copies ±
+        uint32_t count{ 0 };
+        uint32_t bytes{ 0 };  // øֽ֡, 0 ʾȡ
+    };
+
+    std::vector<Entry> table;  // sfid -> Entry, СΪ sfid + 1
+    std::vector<Copy> copies;
+    size_t max_minor_bytes{ 0 };  // ֽ֡, һη
+
+    static PcmExtractPlan compile(const PcmFileConfig &cfg)
+    {
+        PcmExtractPlan plan;
+        if (cfg.sfid2ranges.empty()) return plan;
+        plan.table.resize(cfg.sfid2ranges.rbegin()->first + 1);
+        for (auto &[sfid, ranges] : cfg.sfid2ranges)
+        {
+            auto &entry = plan.table[sfid];
+            entry.first = (uint32_t)plan.copies.size();
+            for (auto &range : ranges)
+            {
+                // Ǳ, ֡ԭԽ, ֱӶ
+                if (range.begin > range.end || range.end >= cfg.pcm.minor_len)
+                {
+                    fmt::println("sfid={:02X}: range [{}, {}] is outside the {} byte minor frame, ignored", sfid, range.begin, range.end, cfg.pcm.minor_len);
+                    continue;
+                }
+                auto len = uint32_t(range.end + 1 - range.begin);
+                // ֻϲ˳βӵ, ˳򲻱
+                if (entry.count > 0)
+                {
+                    auto &last = plan.copies.back();
+                    if (last.src + last.len == range.begin)
+                    {
+                        last.len += len;
+                        entry.bytes += len;
+                        continue;
+                    }
+                }
+                plan.copies.push_back({ (uint32_t)range.begin, entry.bytes, len });
+                entry.count++;
+                entry.bytes += len;
+            }
+            plan.max_minor_bytes = std::max<size_t>(plan.max_minor_bytes, entry.bytes);
+        }
+        return plan;
+    }
+
+    const Entry *find(uint64_t sfid) const
+    {
+        return sfid < table.size() && table[sfid].bytes ? &table[sfid] : nullptr;
+    }
+};
+
+// ֻӳļ, ȡֱӴӳȡ,  ifstream Ļ濽
+struct MappedFile
+{
+    const char *data{ nullptr };
+    size_t size{ 0 };
+#ifdef _WIN32
+    HANDLE file{ INVALID_HANDLE_VALUE };
+    HANDLE mapping{ nullptr };
+#endif
+
+    bool open(const std::string &path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER len;
+        if (!GetFileSizeEx(file, &len) || len.QuadPart == 0) return false;
+        size = (size_t)len.QuadPart;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return false;
+        data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+#else
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        size = (size_t)st.st_size;
+        auto ptr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED) return false;
+        // ̻߳˳ƽ, ں˼ӴԤ
+        ::madvise(ptr, size, MADV_SEQUENTIAL);
+        data = (const char *)ptr;
+        return true;
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) ::munmap((void *)data, size);
+#endif
+    }
+};
+
 class PcmFileReader
 {
 public:
     PcmFileReader(PcmFileConfig cfg)
         : cfg_(std::move(cfg))
+        , plan_(PcmExtractPlan::compile(cfg_))
     {
     }
 
 public:
     void read(const std::function<void(std::string_view)> &callback)
     {
-        size_t major_bytes = cfg_.pcm.major_len * cfg_.pcm.minor_len;
         size_t minor_bytes_with_offset = cfg_.frame_offset + cfg_.pcm.minor_len;
         size_t major_bytes_with_offset = minor_bytes_with_offset * cfg_.pcm.major_len;
         auto buffer_len = std::max(major_bytes_with_offset, cfg_.file_offset);
         std::vector<char> buffer;
         buffer.reserve(buffer_len);
-        std::vector<char> major;
-        major.reserve(major_bytes);
+        std::vector<char> major(plan_.max_minor_bytes * cfg_.pcm.major_len);
 
         std::ifstream input(cfg_.filename, std::ios::binary);
+        // ļͷֻڿͷһ
+        buffer.resize(buffer_len);
+        input.read(buffer.data(), cfg_.file_offset);
         while (input.good())
         {
-            buffer.resize(buffer_len);
-            input.read(buffer.data(), cfg_.file_offset);
             input.read(buffer.data(), major_bytes_with_offset);
             if (input.gcount() != major_bytes_with_offset)
             {
-                fmt::println("finished");
                 break;
             }
-            for (auto i = 0; i < cfg_.pcm.major_len; ++i)
-            {
-                auto line = read_embed_frame({ buffer.data() + i * minor_bytes_with_offset + cfg_.frame_offset, cfg_.pcm.minor_len });
-                std::copy(line.begin(), line.end(), std::back_inserter(major));
-            }
-            callback({ major.data(), major.size() });
-            major.clear();
+            callback({ major.data(), extract(buffer.data(), 1, major.data()) });
         }
     }
 
-private:
-    std::vector<unsigned char> read_embed_frame(std::string_view frame)
+    /**
+     * ӳļ, ֡гԼ chunk_bytes Ŀ, threads ̸߳Գȡһ, ļ˳ڵ߳ｻ callback
+     * callback ÿյһ(֡)ĳȡ, ƴ read ͬ; ÿ߳ 2 , ڴռн
+     * threads Ϊ 0 ʾ CPU ; ļ򲻿 false
+     */
+    bool read_parallel(const std::function<void(std::string_view)> &callback, size_t threads = 0, size_t chunk_bytes = 8 << 20)
     {
-        std::vector<unsigned char> line;
-        auto sfid = read_sfid(frame);
-        if (!cfg_.sfid2ranges.contains(sfid))
+        MappedFile file;
+        if (!file.open(cfg_.filename))
         {
-            return {};
+            fmt::println("open {} failed", cfg_.filename);
+            return false;
         }
+        auto major_bytes_with_offset = (cfg_.frame_offset + cfg_.pcm.minor_len) * cfg_.pcm.major_len;
+        if (major_bytes_with_offset == 0 || file.size < cfg_.file_offset + major_bytes_with_offset) return true;
+        auto majors = (file.size - cfg_.file_offset) / major_bytes_with_offset;
+        auto chunk_majors = std::max<size_t>(1, chunk_bytes / major_bytes_with_offset);
+        auto chunks = (majors + chunk_majors - 1) / chunk_majors;
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, chunks);
+
+        auto window = threads * 2;
+        //  i д outputs[i % window], ֽһη
+        std::vector<std::vector<char>> outputs(window, std::vector<char>(chunk_majors * cfg_.pcm.major_len * plan_.max_minor_bytes));
+        std::vector<size_t> used(window, 0);
+        std::vector<uint8_t> ready(window, 0);
+        size_t next = 0;       // һȡĿ
+        size_t delivered = 0;  // ѽ callback Ŀ
+        std::mutex mutex;
+        std::condition_variable cv;
 
-        auto ptr = frame.data();
-        for (auto &&it : cfg_.sfid2ranges.at(sfid))
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t)
         {
-            std::copy(ptr + it.begin, ptr + it.end + 1, std::back_inserter(line));
+            workers.emplace_back([&] {
+                while (true)
+                {
+                    size_t chunk;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        cv.wait(lock, [&] {
+                            return next >= chunks || next < delivered + window;
+                        });
+                        if (next >= chunks) return;
+                        chunk = next++;
+                    }
+                    auto first = chunk * chunk_majors;
+                    auto bytes = extract(file.data + cfg_.file_offset + first * major_bytes_with_offset, std::min(chunk_majors, majors - first),
+                        outputs[chunk % window].data());
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        used[chunk % window] = bytes;
+                        ready[chunk % window] = 1;
+                    }
+                    cv.notify_all();
+                }
+            });
         }
+        // û쵽Ŀ鲻ٷ, ϵĿ߳˳
+        auto join_workers = [&] {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                next = chunks;
+            }
+            cv.notify_all();
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+        };
+        try
+        {
+            for (size_t chunk = 0; chunk < chunks; ++chunk)
+            {
+                auto slot = chunk % window;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] {
+                        return ready[slot] != 0;
+                    });
+                }
+                callback({ outputs[slot].data(), used[slot] });
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ready[slot] = 0;
+                    delivered++;
+                }
+                cv.notify_all();
+            }
+        }
+        catch (...)
+        {
+            // callback ׳쳣֮ǰջع߳,  workers ʱ߳Կ join ֱ terminate
+            join_workers();
+            throw;
+        }
+        join_workers();
+        return true;
+    }
 
-        fmt::println("sfid={:02X}, embed_bytes={}", sfid, line.size());
+    const PcmExtractPlan &plan() const
+    {
+        return plan_;
+    }
 
-        return line;
+    /** ȡ ptr ʼ count ֡д out, out  count * major_len * plan().max_minor_bytes ֽ, дֽ */
+    size_t extract(const char *ptr, size_t count, char *out) const
+    {
+        auto minor_bytes_with_offset = cfg_.frame_offset + cfg_.pcm.minor_len;
+        auto begin = out;
+        ptr += cfg_.frame_offset;
+        for (size_t i = 0; i < count * cfg_.pcm.major_len; ++i, ptr += minor_bytes_with_offset)
+        {
+            auto entry = plan_.find(read_sfid({ ptr, cfg_.pcm.minor_len }));
+            if (!entry) continue;
+            for (auto copy = &plan_.copies[entry->first], end = copy + entry->count; copy != end; ++copy)
+            {
+                memcpy(out + copy->dst, ptr + copy->src, copy->len);
+            }
+            out += entry->bytes;
+        }
+        return out - begin;
     }
 
-    uint64_t read_sfid(std::string_view frame)
+private:
+
+    uint64_t read_sfid(std::string_view frame) const
     {
-        auto value = *(uint16_t *)(frame.data() + cfg_.pcm.sfid_pos);
+        uint16_t value;
+        memcpy(&value, frame.data() + cfg_.pcm.sfid_pos, sizeof(value));
         auto ptr = (uint8_t *)&value;
         if (cfg_.pcm.sfid_use_bigendian)
         {
@@ -109,6 +341,7 @@ private:
 
 private:
     PcmFileConfig cfg_;
+    PcmExtractPlan plan_;
 };
 
 PcmFileConfig make_file0()
@@ -162,12 +395,116 @@ auto make_file1()
     //    } };
 }
 
-int main(int argc, char **argv)
+//  make_file0 ĸʽ mb MB ļ, Ƚ ifstream ˳ȡӳ̳߳ȡ, Уһ
+int bench(size_t mb, size_t threads)
 {
-    PcmFileReader fr(make_file0());
-    std::ofstream output("embedded.ts", std::ios::binary);
-    fr.read([&output](auto &&frame) {
-        output.write(frame.data(), frame.size());
-        output.flush();
+    auto cfg = make_file0();
+    cfg.filename = (std::filesystem::temp_directory_path() / "video_in_pcm_bench.pcm").string();
+    auto minor_bytes_with_offset = cfg.frame_offset + cfg.pcm.minor_len;
+    auto major_bytes_with_offset = minor_bytes_with_offset * cfg.pcm.major_len;
+    auto majors = (mb << 20) / major_bytes_with_offset;
+    {
+        std::mt19937 rng(1);
+        std::vector<char> major(major_bytes_with_offset);
+        std::ofstream file(cfg.filename, std::ios::binary);
+        for (size_t m = 0; m < majors; ++m)
+        {
+            for (auto &c : major)
+            {
+                c = (char)rng();
+            }
+            for (size_t i = 0; i < cfg.pcm.major_len; ++i)
+            {
+                auto sfid = major.data() + i * minor_bytes_with_offset + cfg.frame_offset + cfg.pcm.sfid_pos;
+                sfid[0] = 0;
+                sfid[1] = (char)i;
+            }
+            file.write(major.data(), major.size());
+        }
+    }
+    auto file_bytes = majors * major_bytes_with_offset;
+
+    PcmFileReader fr(cfg);
+    // ʱֻͳֽ, ֮ռһȽ
+    auto run = [&](const std::string &name, auto &&read) {
+        uint64_t bytes = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        read([&](std::string_view data) {
+            bytes += data.size();
+        });
+        auto s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        fmt::println("{:<10} {:6.2f} GB/s in, {:6.2f} GB/s out  ({} MB -> {} MB, {:.3f} s)", name, file_bytes / s / 1e9, bytes / s / 1e9, file_bytes >> 20,
+            bytes >> 20, s);
+        std::string output;
+        read([&](std::string_view data) {
+            output.append(data);
+        });
+        return output;
+    };
+    // ͬһڴϱȽϳȡ: ֡ map  back_inserter (ԭ) Ԥĳȡƻ
+    {
+        MappedFile file;
+        file.open(cfg.filename);
+        auto extract_map = [&](std::string &out) {
+            for (size_t i = 0; i < majors * cfg.pcm.major_len; ++i)
+            {
+                std::string_view frame{ file.data + i * minor_bytes_with_offset + cfg.frame_offset, cfg.pcm.minor_len };
+                auto sfid = uint64_t((uint8_t)frame[cfg.pcm.sfid_pos]) << 8 | (uint8_t)frame[cfg.pcm.sfid_pos + 1];
+                if (!cfg.sfid2ranges.contains(sfid)) continue;
+                std::vector<unsigned char> line;
+                for (auto &&it : cfg.sfid2ranges.at(sfid))
+                {
+                    std::copy(frame.data() + it.begin, frame.data() + it.end + 1, std::back_inserter(line));
+                }
+                out.append((const char *)line.data(), line.size());
+            }
+        };
+        std::string map_out, plan_out(majors * cfg.pcm.major_len * fr.plan().max_minor_bytes, 0);
+        map_out.reserve(plan_out.size());
+        auto t0 = std::chrono::steady_clock::now();
+        extract_map(map_out);
+        auto t1 = std::chrono::steady_clock::now();
+        plan_out.resize(fr.extract(file.data, majors, plan_out.data()));
+        auto t2 = std::chrono::steady_clock::now();
+        auto map_s = std::chrono::duration<double>(t1 - t0).count(), plan_s = std::chrono::duration<double>(t2 - t1).count();
+        fmt::println("map lookup {:6.2f} GB/s in, plan {:6.2f} GB/s in, {:.1f}x  ({} copies for {} sfids, outputs {})", file_bytes / map_s / 1e9,
+            file_bytes / plan_s / 1e9, map_s / plan_s, fr.plan().copies.size(), cfg.sfid2ranges.size(), map_out == plan_out ? "identical" : "DIFFER");
+    }
+
+    // ˳һ, ֮ҳ, Ƚϵǳȡ
+    auto expected = run("ifstream", [&](auto &&cb) {
+        fr.read(cb);
     });
+    bool same = true;
+    for (size_t n : { size_t(1), threads ? threads : std::max<size_t>(1, std::thread::hardware_concurrency()) })
+    {
+        same &= run(fmt::format("mmap x{}", n), [&](auto &&cb) {
+            fr.read_parallel(cb, n);
+        }) == expected;
+    }
+    std::filesystem::remove(cfg.filename);
+    fmt::println("{}", same ? "outputs identical" : "OUTPUTS DIFFER");
+    return same ? 0 : 1;
+}
+
+//   video_in_pcm [pcm file] [output] [threads]    make_file0 ĸʽȡǶ TS
+//   video_in_pcm bench [MB] [threads]
+int main(int argc, char **argv)
+{
+    if (argc > 1 && std::string_view(argv[1]) == "bench")
+    {
+        return bench(argc > 2 ? std::stoul(argv[2]) : 512, argc > 3 ? std::stoul(argv[3]) : 0);
+    }
+
+    auto cfg = make_file0();
+    if (argc > 1) cfg.filename = argv[1];
+    PcmFileReader fr(cfg);
+    std::ofstream output(argc > 2 ? argv[2] : "embedded.ts", std::ios::binary);
+    return fr.read_parallel(
+               [&output](auto &&chunk) {
+                   output.write(chunk.data(), chunk.size());
+               },
+               argc > 3 ? std::stoul(argv[3]) : 0)
+               ? 0
+               : 1;
 }